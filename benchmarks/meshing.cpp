@@ -0,0 +1,188 @@
+#include "VoxelChunk.hpp"
+#include "Config.hpp"
+#include "Stopwatch.hpp"
+#include "Utils.hpp"
+#include "World.hpp"
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+/*	Meshes a square of generated chunks with every MeshingMode and reports the time per chunk.
+	Scalar and Bitmask have to produce identical vertex buffers, and Greedy quads have to cover exactly the
+	faces of the scalar mesh, the run fails otherwise. Every section is then remeshed alone, which has to
+	leave the faces of the mesh unchanged. */
+
+using namespace vox;
+
+static constexpr i32	gridSize = 5;
+static constexpr i32	iterations = 20;
+
+struct ModeInfo
+{
+	MeshingMode	mode;
+	const char*	name;
+};
+
+static constexpr std::array<ModeInfo, 3> modes{{
+	{MeshingMode::Scalar, "scalar"},
+	{MeshingMode::Bitmask, "bitmask"},
+	{MeshingMode::Greedy, "greedy"}
+}};
+
+/*	Every voxel face covered by the quads of a mesh, as a packed corner, face and type, sorted. A scalar
+	quad covers one face, a greedy one the whole rectangle between its corners. */
+
+static std::vector<ui32>	unitFaces(const VertexVector& vertexes)
+{
+	std::vector<ui32>	faces;
+
+	for (size_t quad = 0; quad + 4 <= vertexes.size(); quad += 4)
+	{
+		const ui32		word = vertexes[quad].words[0];
+		const size_t	face = unpackVertexFace(word);
+		const VoxelType	type = static_cast<VoxelType>(word >> (PACKED_X_BITS + PACKED_Y_BITS + PACKED_Z_BITS + PACKED_FACE_BITS));
+		vec3i			low = unpackVertexPosition(word);
+		vec3i			high = low;
+
+		for (size_t corner = 1; corner < 4; corner++)
+		{
+			const vec3i position = unpackVertexPosition(vertexes[quad + corner].words[0]);
+
+			low = vec3i{std::min(low.x, position.x), std::min(low.y, position.y), std::min(low.z, position.z)};
+			high = vec3i{std::max(high.x, position.x), std::max(high.y, position.y), std::max(high.z, position.z)};
+		}
+		// the axis of the normal is flat, the loops still run once on it
+		for (i32 y = low.y; y < std::max(high.y, low.y + 1); y++)
+		{
+			for (i32 z = low.z; z < std::max(high.z, low.z + 1); z++)
+			{
+				for (i32 x = low.x; x < std::max(high.x, low.x + 1); x++)
+				{
+					faces.push_back(packVertexPosition(vec3i{x, y, z}, face, type));
+				}
+			}
+		}
+	}
+	std::sort(faces.begin(), faces.end());
+	return faces;
+}
+
+int	main( void )
+{
+	VoxelChunk::setDimensions(vec3i{Config::chunkLength, Config::chunkHeight, Config::chunkLength});
+
+	std::vector<std::unique_ptr<VoxelChunk>> chunks;
+
+	for (i32 z = 0; z < gridSize; z++)
+	{
+		for (i32 x = 0; x < gridSize; x++)
+		{
+			chunks.push_back(std::make_unique<VoxelChunk>(vec2i{x, z}));
+		}
+	}
+
+	auto chunkAt = [&chunks](i32 x, i32 z) -> VoxelChunk*
+	{
+		if (x < 0 || z < 0 || x >= gridSize || z >= gridSize)
+		{
+			return nullptr;
+		}
+		return chunks[z * gridSize + x].get();
+	};
+
+	for (i32 z = 0; z < gridSize; z++)
+	{
+		for (i32 x = 0; x < gridSize; x++)
+		{
+			chunkAt(x, z)->generateMap(0.0f);
+		}
+	}
+	for (i32 z = 0; z < gridSize; z++)
+	{
+		for (i32 x = 0; x < gridSize; x++)
+		{
+			chunkAt(x, z)->copyAdjacentData({chunkAt(x, z + 1), chunkAt(x + 1, z), chunkAt(x, z - 1), chunkAt(x - 1, z)});
+		}
+	}
+
+	std::vector<VertexVector> reference;
+	std::vector<std::vector<ui32>> referenceFaces;
+	double scalarTime = 0.0;
+
+	for (const ModeInfo& info : modes)
+	{
+		Stopwatch timer;
+		size_t vertexCount = 0;
+
+		timer.start();
+		for (i32 i = 0; i < iterations; i++)
+		{
+			for (std::unique_ptr<VoxelChunk>& chunk : chunks)
+			{
+				chunk->generateVertexes(info.mode);
+			}
+		}
+		timer.stop();
+
+		const double perChunk = timer.elapsed(Unit::Microseconds) / (iterations * chunks.size());
+
+		for (size_t i = 0; i < chunks.size(); i++)
+		{
+			vertexCount += chunks[i]->getVertexSize();
+			if (info.mode == MeshingMode::Scalar)
+			{
+				reference.push_back(chunks[i]->getVertexData());
+				referenceFaces.push_back(unitFaces(reference.back()));
+			}
+			else if (info.mode == MeshingMode::Bitmask && reference[i] != chunks[i]->getVertexData())
+			{
+				std::cerr << "Error: bitmask mesh of chunk " << i << " differs from the scalar mesh" << std::endl;
+				return EXIT_FAILURE;
+			}
+			else if (info.mode == MeshingMode::Greedy && referenceFaces[i] != unitFaces(chunks[i]->getVertexData()))
+			{
+				std::cerr << "Error: greedy mesh of chunk " << i << " doesn't cover the faces of the scalar mesh" << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		if (info.mode == MeshingMode::Scalar)
+		{
+			scalarTime = perChunk;
+		}
+		std::cout << info.name << ": " << perChunk << " us per chunk, "
+			<< vertexCount << " vertexes (" << formatBytes(vertexCount * sizeof(TerrainVertex)) << "), "
+			<< "speedup " << scalarTime / perChunk << "x" << std::endl;
+	}
+
+	// remeshing every section one by one has to give back the faces of the whole mesh
+	Stopwatch timer;
+	i32 remeshed = 0;
+
+	timer.start();
+	for (std::unique_ptr<VoxelChunk>& chunk : chunks)
+	{
+		for (i32 section = 0; section < VoxelChunk::sectionCount; section++)
+		{
+			if (chunk->getSectionState(section) != SectionState::Air)
+			{
+				chunk->remeshSection(section);
+				remeshed++;
+			}
+		}
+	}
+	timer.stop();
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		if (referenceFaces[i] != unitFaces(chunks[i]->getVertexData()))
+		{
+			std::cerr << "Error: section remesh of chunk " << i << " doesn't cover the faces of the scalar mesh" << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	std::cout << "section: " << timer.elapsed(Unit::Microseconds) / std::max(remeshed, 1) << " us per section, "
+		<< remeshed << " sections remeshed" << std::endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,94 @@
+#include "ThreadManager.hpp"
+#include "Stopwatch.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+/*	Counts the heap allocations made per task by each way of queuing one on the pool, once the pool
+	and its task slots are warm, and the time per task. Fails if submit allocates. */
+
+static std::atomic<size_t>	allocations{0};
+
+void*	operator new(size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* memory = std::malloc(size == 0 ? 1 : size))
+	{
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void*	operator new(size_t size, std::align_val_t alignment)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* memory = std::aligned_alloc(static_cast<size_t>(alignment), (size + static_cast<size_t>(alignment) - 1) & ~(static_cast<size_t>(alignment) - 1)))
+	{
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void	operator delete(void* memory) noexcept { std::free(memory); }
+void	operator delete(void* memory, size_t) noexcept { std::free(memory); }
+void	operator delete(void* memory, std::align_val_t) noexcept { std::free(memory); }
+void	operator delete(void* memory, size_t, std::align_val_t) noexcept { std::free(memory); }
+
+static constexpr int	taskCount = 100000;
+static constexpr int	rounds = 3;
+
+/*	allocationFree: the way of queuing must not allocate once warm, the run fails if it does. */
+
+template <class Queue>
+static void	measure(const char* name, bool allocationFree, ThreadManager& pool, Queue queue)
+{
+	std::atomic<long>	sum{0};
+	size_t				before;
+	Stopwatch			timer;
+
+	// the first round warms the slots and the rings of the workers
+	for (int round = 0; round < rounds; round++)
+	{
+		before = allocations.load();
+		timer.start();
+		for (int i = 0; i < taskCount; i++)
+		{
+			queue(pool, sum, i);
+		}
+		pool.waitIdle();
+		timer.stop();
+	}
+
+	const double perTask = static_cast<double>(allocations.load() - before) / taskCount;
+
+	std::cout << name << ": " << perTask << " allocations per task, "
+		<< timer.elapsed(Unit::Nanoseconds) / taskCount << " ns per task" << std::endl;
+	if (allocationFree == true && perTask > 0.01)
+	{
+		std::cerr << "Error: " << name << " allocates" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+}
+
+int	main( void )
+{
+	ThreadManager	pool;
+	TaskGroup		group;
+
+	measure("enqueue", false, pool, [](ThreadManager& pool, std::atomic<long>& sum, int i) {
+		pool.enqueue([&sum, i] { sum.fetch_add(i, std::memory_order_relaxed); });
+	});
+	measure("enqueue in a group", false, pool, [&group](ThreadManager& pool, std::atomic<long>& sum, int i) {
+		pool.enqueue(group, [&sum, i] { sum.fetch_add(i, std::memory_order_relaxed); });
+	});
+	measure("submit", true, pool, [](ThreadManager& pool, std::atomic<long>& sum, int i) {
+		pool.submit([&sum, i] { sum.fetch_add(i, std::memory_order_relaxed); });
+	});
+	measure("submit in a group", true, pool, [&group](ThreadManager& pool, std::atomic<long>& sum, int i) {
+		pool.submit(group, [&sum, i] { sum.fetch_add(i, std::memory_order_relaxed); });
+	});
+	pool.wait(group);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,119 @@
+#include "ThreadManager.hpp"
+#include "VoxelChunk.hpp"
+#include "Config.hpp"
+#include "Stopwatch.hpp"
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/*	Runs the same work on pools of 1 to N threads and reports the time and the speedup over a single
+	thread: many tiny tasks, where the cost of the queue dominates, the same tiny work split by
+	parallel_for, tasks that enqueue more tasks, and chunk generation, the real workload of the pool. */
+
+using namespace vox;
+
+static constexpr i32	tinyTasks = 200000;
+static constexpr size_t	tinyGrain = 1024;
+static constexpr i32	spawningTasks = 2000;
+static constexpr i32	spawnedPerTask = 50;
+static constexpr i32	chunkCount = 64;
+
+static double	runTiny(ThreadManager& pool)
+{
+	std::atomic<ui64>	sum{0};
+	Stopwatch			timer;
+
+	timer.start();
+	for (i32 i = 0; i < tinyTasks; i++)
+	{
+		pool.enqueue([&sum, i] {
+			sum.fetch_add(static_cast<ui64>(i) * i, std::memory_order_relaxed);
+		});
+	}
+	pool.waitIdle();
+	timer.stop();
+	return timer.elapsed(Unit::Milliseconds);
+}
+
+static double	runParallelFor(ThreadManager& pool)
+{
+	std::atomic<ui64>	sum{0};
+	Stopwatch			timer;
+
+	timer.start();
+	pool.parallel_for(0, tinyTasks, tinyGrain, [&sum](size_t i) {
+		sum.fetch_add(static_cast<ui64>(i) * i, std::memory_order_relaxed);
+	});
+	timer.stop();
+	return timer.elapsed(Unit::Milliseconds);
+}
+
+static double	runSpawning(ThreadManager& pool)
+{
+	std::atomic<ui64>	sum{0};
+	Stopwatch			timer;
+
+	timer.start();
+	for (i32 i = 0; i < spawningTasks; i++)
+	{
+		pool.enqueue([&pool, &sum] {
+			for (i32 j = 0; j < spawnedPerTask; j++)
+			{
+				pool.enqueue([&sum, j] {
+					sum.fetch_add(static_cast<ui64>(j), std::memory_order_relaxed);
+				});
+			}
+		});
+	}
+	pool.waitIdle();
+	timer.stop();
+	return timer.elapsed(Unit::Milliseconds);
+}
+
+static double	runChunks(ThreadManager& pool)
+{
+	std::vector<std::shared_ptr<VoxelChunk>>	chunks;
+	Stopwatch									timer;
+
+	for (i32 i = 0; i < chunkCount; i++)
+	{
+		chunks.push_back(std::make_shared<VoxelChunk>(vec2i{i % 8, i / 8}));
+	}
+	timer.start();
+	for (const std::shared_ptr<VoxelChunk>& chunk : chunks)
+	{
+		pool.enqueue([chunk] {
+			chunk->generateMap(0.0f);
+		});
+	}
+	pool.waitIdle();
+	timer.stop();
+	return timer.elapsed(Unit::Milliseconds);
+}
+
+int	main( void )
+{
+	const unsigned	maxThreads = std::max(1U, std::thread::hardware_concurrency());
+	double			baseline[4] = {0.0, 0.0, 0.0, 0.0};
+
+	VoxelChunk::setDimensions(vec3i{Config::chunkLength, Config::chunkHeight, Config::chunkLength});
+	for (unsigned threads = 1; threads <= maxThreads; threads++)
+	{
+		ThreadManager	pool(threads);
+		const double	times[4] = {runTiny(pool), runParallelFor(pool), runSpawning(pool), runChunks(pool)};
+
+		if (threads == 1)
+		{
+			std::copy(times, times + 4, baseline);
+		}
+		std::cout << threads << " threads: "
+			<< tinyTasks << " tiny tasks " << times[0] << " ms (" << baseline[0] / times[0] << "x), "
+			<< tinyTasks << " parallel_for items " << times[1] << " ms (" << baseline[1] / times[1] << "x), "
+			<< spawningTasks * spawnedPerTask << " spawned tasks " << times[2] << " ms (" << baseline[2] / times[2] << "x), "
+			<< chunkCount << " chunks " << times[3] << " ms (" << baseline[3] / times[3] << "x)" << std::endl;
+	}
+	return EXIT_SUCCESS;
+}
@@ -35,6 +35,7 @@ class Camera
 		const mat4&	getViewMatrix( void ) noexcept;
 
 		vec3 const&	getCameraPos( void ) noexcept;
+		vec3 const&	getCameraForward( void ) const noexcept;
 
 		void	moveForward( float ) noexcept;
 		void	moveBackward( float ) noexcept;
@@ -2,16 +2,32 @@
 
 #include "Vectors.hpp"
 
+#include <array>
+
 
 namespace vox {
 
+using ui8 = uint8_t;
+using i32 = int32_t;
 using ui32 = uint32_t;
 
+/*	Shape of the set of chunks kept around the player, all of them fit in the square of side
+	2 * minimumViewingDistance. */
+
+enum class ViewShape : ui8
+{
+	Square,
+	Circle,
+	Diamond
+};
+
 struct Config
 {
 	static constexpr ui32	defaultWindowWidth = 1300;
 	static constexpr ui32	defaultWindowHeight = 1300;
 	static constexpr ui32	minimumViewingDistance = 160;
+	static constexpr i32	maximumViewDistance = 32;	// in chunks, for the runtime setting
+	static constexpr ViewShape	viewShape = ViewShape::Circle;
 
 	static constexpr float	noiseScalar = 0.01f;
 
@@ -31,6 +47,29 @@ struct Config
 	static constexpr i32	chunkHeight = 256U;
 	static constexpr i32	seaLevel = 64U;
 
+	// merge coplanar faces of the same voxel type into larger quads when meshing a chunk
+	static constexpr bool	greedyMeshing = false;
+
+	// distance in chunks from the chunk of the player where chunks switch to level of detail 1, 2 and 3,
+	// made of cells of 2, 4 and 8 voxels per side
+	static constexpr std::array<i32, 3>	lodDistances{4, 6, 8};
+
+	// chunks generated ahead of the view along the velocity of the camera, at most prefetchRings
+	// chunks beyond it and prefetchSeconds of travel away, with up to prefetchJobs of them in flight
+	static constexpr i32	prefetchRings = 2;
+	static constexpr float	prefetchSeconds = 1.0f;
+	static constexpr i32	prefetchJobs = 8;
+
+	// chunks that left the map kept for when the player comes back, least recently evicted dropped first
+	static constexpr size_t	chunkCacheSize = 256;
+
+	// time and bytes per frame for swapping in and uploading new chunk meshes, the time adapts between
+	// the two limits to keep frames under frameTimeTarget, the rest waits for the next frames
+	static constexpr double	frameTimeTarget = 20.0;	// a 60 Hz frame with room for the vsync wait
+	static constexpr double	uploadMinimumMs = 1.0;
+	static constexpr double	uploadMaximumMs = 6.0;
+	static constexpr size_t	uploadBytesPerFrame = 16 * 1024 * 1024;
+
 	static constexpr float	movementSpeed = 100.0f;
 	static constexpr float	lookSpeed = 75.0f;
 
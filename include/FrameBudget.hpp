@@ -0,0 +1,40 @@
+#pragma once
+
+#include "Stopwatch.hpp"
+
+#include <cstddef>
+
+/*	Share of a frame given to work that can wait for the next one, like uploading new chunk meshes.
+	The time allowance adapts to the measured frame time: it shrinks while frames run over the target
+	and grows back while they fit, between a floor and a ceiling. The byte allowance is fixed. The
+	first piece of work of a frame always runs, so the backlog keeps draining however small the
+	allowance gets. */
+
+class FrameBudget
+{
+	public:
+		FrameBudget(double targetMs, double minimumMs, double maximumMs, size_t bytesPerFrame) noexcept;
+		~FrameBudget() noexcept = default;
+		FrameBudget(const FrameBudget& other) = delete;
+		FrameBudget(FrameBudget&& other) = delete;
+		FrameBudget& operator=(const FrameBudget& other) = delete;
+		FrameBudget& operator=(FrameBudget&& other) = delete;
+
+		void	beginFrame() noexcept;
+		void	endFrame(double frameMs) noexcept;
+
+		bool	exhausted() const noexcept;
+		void	spend(size_t bytes) noexcept;
+
+		double	getAllowance() const noexcept { return allowanceMs; }
+
+	private:
+		double	targetMs;
+		double	minimumMs;
+		double	maximumMs;
+		double	allowanceMs;
+		size_t	bytesPerFrame;
+		size_t	bytesSpent;
+		size_t	workDone;
+		Time	frameStart;
+};
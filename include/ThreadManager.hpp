@@ -1,10 +1,16 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <condition_variable>
 #include <cstddef>
+#include <cstring>
 #include <future>
+#include <memory>
 #include <mutex>
-#include <queue>
+#include <new>
+#include <stdexcept>
 #include <thread>
 #include <type_traits>
 #include <utility>
@@ -12,10 +18,159 @@
 #include <functional>
 
 
+/*	Tasks of a pool that can be waited for apart from the others, see ThreadManager::wait. A group
+	has to outlive its tasks: wait for it before it goes out of scope. */
+
+class TaskGroup
+{
+	public:
+		TaskGroup() noexcept : pending(0) {};
+		~TaskGroup() noexcept = default;
+
+		TaskGroup(const TaskGroup&) = delete;
+		TaskGroup(TaskGroup&&) = delete;
+		TaskGroup& operator=(const TaskGroup&) = delete;
+		TaskGroup& operator=(TaskGroup&&) = delete;
+
+		bool	isDone() const noexcept { return pending.load() == 0; }
+
+	private:
+		friend class ThreadManager;
+		friend class TaskHandle;
+
+		void	finish();
+
+		std::atomic<int>		pending;
+		std::mutex				mutex;
+		std::condition_variable	cv;
+};
+
+/*	Lane of a task in the pool. Workers take urgent tasks first, then normal, then background ones,
+	but regularly look at the lower lanes first so a steady flow of urgent work can't starve them. */
+
+enum class TaskPriority
+{
+	Urgent,
+	Normal,
+	Background
+};
+
+/*	Task whose priority can be raised after it was submitted, see ThreadManager::submitRaisable. Raising
+	it queues it again in the higher lane: whichever copy starts first runs it, the other does nothing. */
+
+class TaskHandle
+{
+	public:
+		TaskHandle(std::function<void()> function, TaskPriority priority, TaskGroup* group) :
+			function(std::move(function)), priority(priority), started(false), group(group) {};
+		~TaskHandle() noexcept = default;
+
+		TaskHandle(const TaskHandle&) = delete;
+		TaskHandle(TaskHandle&&) = delete;
+		TaskHandle& operator=(const TaskHandle&) = delete;
+		TaskHandle& operator=(TaskHandle&&) = delete;
+
+		TaskPriority	getPriority() const noexcept { return priority.load(); }
+		bool			hasStarted() const noexcept { return started.load(); }
+
+	private:
+		friend class ThreadManager;
+
+		void	runOnce() noexcept;
+
+		std::function<void()>		function;
+		std::atomic<TaskPriority>	priority;
+		std::atomic<bool>			started;
+		TaskGroup*					group;
+};
+
+/*	Storage of a queued task, taken from slabs pooled for the whole program so submitting a task
+	doesn't allocate once the pool is warm. A callable of up to inlineSize bytes is built in place,
+	a bigger one is allocated on the heap and the slot keeps its address. If building the callable
+	throws, the slot goes back to the pool before the exception leaves make. */
+
+struct alignas(64) TaskSlot
+{
+	static constexpr size_t	inlineSize = 48;
+
+	alignas(std::max_align_t) std::byte	storage[inlineSize];
+	union
+	{
+		void		(*run)(TaskSlot& slot, bool invoke);	// calls the callable if invoke, then destroys it, while queued
+		TaskSlot*	next;									// while free
+	};
+	TaskGroup*	group;
+
+	static TaskSlot*	acquire();
+	static void			release(TaskSlot* slot) noexcept;
+	static void			discard(TaskSlot* slot) noexcept;
+
+	template <class F>
+	static TaskSlot*	make(F&& function, TaskGroup* group)
+	{
+		using Callable = std::decay_t<F>;
+
+		if constexpr (sizeof(Callable) <= inlineSize && alignof(Callable) <= alignof(std::max_align_t))
+		{
+			TaskSlot*	slot = acquire();
+
+			try
+			{
+				new (slot->storage) Callable(std::forward<F>(function));
+			}
+			catch (...)
+			{
+				release(slot);
+				throw;
+			}
+			slot->run = [](TaskSlot& self, bool invoke) {
+				Callable& callable = *std::launder(reinterpret_cast<Callable*>(self.storage));
+
+				if (invoke == true)
+				{
+					callable();
+				}
+				callable.~Callable();
+			};
+			slot->group = group;
+			return slot;
+		}
+		else
+		{
+			std::unique_ptr<Callable>	owner = std::make_unique<Callable>(std::forward<F>(function));
+			TaskSlot*					slot = acquire();
+			Callable*					callable = owner.release();
+
+			std::memcpy(slot->storage, &callable, sizeof(callable));
+			slot->run = [](TaskSlot& self, bool invoke) {
+				Callable* heapCallable;
+
+				std::memcpy(&heapCallable, self.storage, sizeof(heapCallable));
+				std::unique_ptr<Callable> owner(heapCallable);
+
+				if (invoke == true)
+				{
+					(*owner)();
+				}
+			};
+			slot->group = group;
+			return slot;
+		}
+	}
+};
+
+static_assert(sizeof(TaskSlot) == 64, "a task slot fills one cache line");
+
+/*	Work-stealing thread pool. Every worker owns a deque of tasks per priority lane: it pushes and pops
+	its own tasks at the back, idle workers steal from the front of the others. Tasks enqueued from
+	outside the pool are spread over the deques in turn, so no single lock is shared by every enqueue
+	and every pop. */
+
 class ThreadManager
 {
 	public:
 		ThreadManager();
+		explicit ThreadManager(unsigned workers);
 		~ThreadManager() noexcept;
 		
 		ThreadManager(const ThreadManager&) = delete;
@@ -26,6 +181,9 @@ class ThreadManager
 		void	joinWorkerThreads();
 		void	stop();
 		void	waitIdle();
+		void	wait(TaskGroup& group);
+
+		size_t	workerCount() const noexcept { return workers.size(); }
 
 		/*	Adds a task to the pool and activates an idle thread to execute it. */
 
@@ -34,32 +192,157 @@ class ThreadManager
 		{
 			using R = std::invoke_result_t<F>;
 
+			ensureRunning();
+
+			std::shared_ptr	task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(function));
+			std::future<R>	fut = task->get_future();
+
+			push(TaskSlot::make([task] { (*task)(); }, nullptr), TaskPriority::Normal);
+			return fut;
+		}
+
+		/*	Adds a task of group to the pool. */
+
+		template <class F>
+		std::future<std::invoke_result_t<F>> enqueue(TaskGroup& group, F&& function)
+		{
+			using R = std::invoke_result_t<F>;
+
+			ensureRunning();
+
 			std::shared_ptr	task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(function));
 			std::future<R>	fut = task->get_future();
 
+			TaskSlot*	slot = TaskSlot::make([task] { (*task)(); }, &group);
+
+			group.pending.fetch_add(1);
+			push(slot, TaskPriority::Normal);
+			return fut;
+		}
+
+		/*	Adds a task without a future, which doesn't allocate when its captures fit in a TaskSlot. The
+			task must not throw, there is nobody to hand the exception to. */
+
+		template <class F>
+		void	submit(F&& function)
+		{
+			ensureRunning();
+			push(TaskSlot::make(std::forward<F>(function), nullptr), TaskPriority::Normal);
+		}
+
+		template <class F>
+		void	submit(TaskGroup& group, F&& function)
+		{
+			ensureRunning();
+
+			TaskSlot*	slot = TaskSlot::make(std::forward<F>(function), &group);
+
+			group.pending.fetch_add(1);
+			push(slot, TaskPriority::Normal);
+		}
+
+		template <class F>
+		void	submit(TaskPriority priority, F&& function)
+		{
+			ensureRunning();
+			push(TaskSlot::make(std::forward<F>(function), nullptr), priority);
+		}
+
+		template <class F>
+		void	submit(TaskGroup& group, TaskPriority priority, F&& function)
+		{
+			ensureRunning();
+
+			TaskSlot*	slot = TaskSlot::make(std::forward<F>(function), &group);
+
+			group.pending.fetch_add(1);
+			push(slot, priority);
+		}
+
+		/*	Adds a task whose priority can be raised later with raise. The handle allocates, keep it for
+			tasks that may really need it. */
+
+		std::shared_ptr<TaskHandle>	submitRaisable(TaskGroup& group, TaskPriority priority, std::function<void()> function);
+		void						raise(const std::shared_ptr<TaskHandle>& handle, TaskPriority priority);
+
+		/*	Calls function(i) for every i in [begin, end). The range is handed out in pieces of grain
+			indexes to as many tasks as there are workers and to the calling thread, each one taking the
+			next piece when done with the last, so uneven pieces balance out. Returns once every index is
+			done. function must not throw, like a submitted task. */
+
+		template <class F>
+		void	parallel_for(size_t begin, size_t end, size_t grain, F&& function)
+		{
+			if (begin >= end)
 			{
-				std::lock_guard<std::mutex> lock(mutex);
+				return;
+			}
+			grain = grain == 0 ? 1 : grain;
 
-				if (shouldRun == false)
+			const size_t		pieces = (end - begin + grain - 1) / grain;
+			std::atomic<size_t>	next{begin};
+			TaskGroup			group;
+			auto				work = [&next, end, grain, &function] {
+				for (size_t first = next.fetch_add(grain); first < end; first = next.fetch_add(grain))
 				{
-					throw std::runtime_error("enqueue on stopped ThreadPool");
+					const size_t last = std::min(first + grain, end);
+
+					for (size_t i = first; i < last; i++)
+					{
+						function(i);
+					}
 				}
-				jobs.emplace([task] { (*task)(); });
+			};
+
+			for (size_t i = 1; i < std::min(pieces, workers.size() + 1); i++)
+			{
+				submit(group, work);
 			}
-			cv.notify_one();
-			return fut;
+			work();
+			wait(group);
 		}
 
 	private:
+
+		static constexpr size_t	laneCount = 3;
+
+		/*	Ring of the tasks of a lane, it only grows so a warm pool never allocates. */
+
+		struct Lane
+		{
+			std::vector<TaskSlot*>	ring;
+			size_t					head = 0;
+			size_t					count = 0;
+
+			void		pushBack(TaskSlot* slot);
+			TaskSlot*	popBack() noexcept;
+			TaskSlot*	popFront() noexcept;
+		};
+
+		struct Worker
+		{
+			std::mutex					mutex;
+			std::array<Lane, laneCount>	lanes;
+		};
+
+		void	ensureRunning() const;
+		void	push(TaskSlot* task, TaskPriority priority);
+		TaskSlot*	pop(size_t self);
+		TaskSlot*	steal(size_t thief, size_t lane);
+		void	run(TaskSlot* task) noexcept;
+		void	workerLoop(size_t self);
 		
-		void	workerLoop();
-		
-		std::condition_variable	cv;
-		std::condition_variable	idleCv;
+		std::vector<std::unique_ptr<Worker>>	workers;
 		std::vector<std::thread>	workerThreads;
-		std::queue<std::function<void()>> jobs;
-		std::mutex	mutex;
+		std::atomic<size_t>	nextWorker;		// deque of the next task enqueued from outside the pool
+		std::atomic<int>	queuedTasks;	// in the deques, not started yet
+		std::array<std::atomic<int>, laneCount>	laneTasks;	// queuedTasks of each lane, not popped yet
+		std::atomic<int>	pendingTasks;	// enqueued and not finished yet
+		std::atomic<int>	sleepingWorkers;
+		std::atomic<bool>	shouldRun;
 
-		bool	shouldRun;
-		int		activeWorkers;
-};
\ No newline at end of file
+		std::mutex				sleepMutex;
+		std::condition_variable	cv;
+		std::mutex				idleMutex;
+		std::condition_variable	idleCv;
+};
@@ -38,7 +38,7 @@ class MatrixUBO
 class Vox
 {
 	public:
-		Vox( void );
+		Vox( i32 viewDistance, ui64 memoryBudget );
 		~Vox( void ) noexcept {};
 		Vox( Vox const& ) = delete;
 		Vox( Vox&& ) = delete;
@@ -49,6 +49,7 @@ class Vox
 		void run( void );
 
 		void moveCamera( float );
+		void changeViewDistance( void );
 		void rotateCameraFromCursorPos( vec2 const& );
 		void resizeWindow( ui32, ui32 );
 
@@ -59,13 +60,15 @@ class Vox
 		ve::VulkanDevice				vulkanDevice;
 		ve::VulkanRenderer				vulkanRenderer;
 		ve::VulkanDescriptorSetFactory	vulkanSetFactory;
+		ve::VulkanQuadIndexBuffer		quadIndexBuffer;
+		ve::VulkanVertexArena			vertexArena;
 
 		Camera			camera;
+		ThreadManager	threadManager;	// before voxelMap, whose jobs run on it until it is destroyed
 		VoxelMap		voxelMap;
+		FrameBudget		uploadBudget;
 		InputHandler	inputHandler;
-		ThreadManager	threadManager;
 
-		std::unique_ptr<ve::VulkanModel> terrainModel;
 		std::unique_ptr<ve::VulkanModel> skyBoxModel;
 
 		std::unique_ptr<ve::VulkanDescriptorSet> matrixDescriptorSet;
@@ -1,16 +1,21 @@
 #pragma once
 
 #include <array>
+#include <memory>
 #include <vector>
+#include "Config.hpp"
 #include "VulkanModel.hpp"
 #include "Vectors.hpp"
 
 namespace vox {
 
 using ui8 = uint8_t;
+using ui16 = uint16_t;
 using i32 = int32_t;
 using ui32 = uint32_t;
-using VertexVector = std::vector<ve::VulkanModel::Vertex>;
+using ui64 = uint64_t;
+using TerrainVertex = ve::VulkanModel::PackedVertex;
+using VertexVector = std::vector<TerrainVertex>;
 using IndexVector = std::vector<ui32>;
 
 enum class VoxelType : ui8
@@ -22,10 +27,39 @@ enum class VoxelType : ui8
 	Padding = 255
 };
 
-class VoxelChunk
+enum class MeshingMode : ui8
+{
+	Scalar,		// reference mesher, compares the 6 neighbours of every voxel
+	Bitmask,	// same faces as Scalar, derived from 64 bit column masks
+	Greedy		// bitmask culling, then coplanar faces merged into larger quads
+};
+
+enum class Direction : ui8
 {
-	using VertexVector = std::vector<ve::VulkanModel::Vertex>;
+	North,
+	East,
+	South,
+	West
+};
+
+class VoxelChunk;
+
+/*	The chunks around a chunk, indexed by Direction, nullptr where the map ends. */
 
+using Neighbours = std::array<const VoxelChunk*, 4>;
+
+/*	State of a 16 voxel high slice of a chunk, used to skip the slices that hold a single kind of voxel
+	when meshing, and to remesh one slice alone with remeshSection. */
+
+enum class SectionState : ui8
+{
+	Air,		// only air
+	Solid,		// no air at all (water included)
+	Mixed
+};
+
+class VoxelChunk
+{
 	public:
 
 		VoxelChunk() = delete;
@@ -41,13 +75,41 @@ class VoxelChunk
 		static ui32		paddedSize;
 		static ui32		chunkSize;
 
+		static void	setDimensions(const vec3i& dimensions) noexcept;
+
 		void	generateMap(float seed);
+		void	copyAdjacentData(const Neighbours& neighbours);
 		void	generateVertexes();
+		void	generateVertexes(MeshingMode mode);
+		void	remeshBorder(Direction side, const VoxelChunk& neighbour);
+		void	remeshSection(i32 section);
 
 		const VertexVector&	getVertexData() const noexcept { return vertexes; }
 
-		void	setAdjacentChunks(VoxelChunk* north, VoxelChunk* east, VoxelChunk* south, VoxelChunk* west) noexcept;
+		static constexpr i32	sectionHeight = 16;
+		static constexpr i32	sectionCount = Config::chunkHeight / sectionHeight;
+
+		SectionState	getSectionState(i32 section) const noexcept { return sections[section]; }
+
+		/*	Number of non-air voxels of a column, counted from the bottom: the column is solid (or water)
+			up to that height and air above it. */
+
+		i32		getColumnHeight(i32 x, i32 z) const noexcept { return heightmap[z * Config::chunkLength + x]; }
+		i32		getMinHeight() const noexcept { return minHeight; }
+		i32		getMaxHeight() const noexcept { return maxHeight; }
+
+		bool	needsUpload() const noexcept { return meshOutdated; }
+		std::unique_ptr<ve::VulkanModel>	uploadMesh(ve::VulkanVertexArena& arena, ve::VulkanQuadIndexBuffer& quadIndexes);
+		ve::VulkanModel*	getMesh() const noexcept { return mesh.get(); }
+		std::unique_ptr<ve::VulkanModel>	releaseMesh() noexcept { return std::move(mesh); }
+
 		void	setLocation(vec2i loc);
+		const vec2i&	getLocation() const noexcept { return location; }
+
+		/*	Level of detail: the chunk is built from cells of 2^lod voxels per side, takes effect at the next generateMap. */
+
+		void	setLod(ui8 level) noexcept { lod = level; }
+		ui8		getLod() const noexcept { return lod; }
 
 		size_t	getVertexSize() const noexcept { return vertexes.size(); }
 		i32		index(i32 x, i32 y, i32 z) const noexcept { return ((z * paddedDimensions.x) + x) * paddedDimensions.y + y; }
@@ -56,14 +118,36 @@ class VoxelChunk
 		const VoxelType*	dataAt(i32 index) const noexcept { return map.data() + index; }
 
 	private:
-		
+
+		/*	One bit per voxel of a column, bit b of word w is the voxel at padded height 1 + 64 * w + b. */
+
+		static constexpr i32	maskWords = Config::chunkHeight / 64;
+		using ColumnMask = std::array<ui64, maskWords>;
+
+		static_assert(Config::chunkHeight % 64 == 0, "chunk height must be a multiple of 64 for the column masks");
+		static_assert(64 % sectionHeight == 0, "a column mask word must hold whole sections");
+
 		vec2i	location;
 		vec3i	worldPosition;
+		ui8		lod = 0;
 		std::vector<VoxelType>	map;
+		std::array<SectionState, sectionCount>	sections{};
+		std::array<ui16, Config::chunkLength * Config::chunkLength>	heightmap{};
+		i32		minHeight = 0;
+		i32		maxHeight = 0;
 		VertexVector			vertexes;
-		std::array<VoxelChunk*, 4>	adjacentChunks{};
+		std::unique_ptr<ve::VulkanModel>	mesh;
+		bool					meshOutdated = false;
 	
-		void	copyAdjacentData();
+		MeshingMode	defaultMeshingMode() const noexcept;
+		i32		usedMaskWords() const noexcept { return (maxHeight + 63) / 64; }
+		void	setSections() noexcept;
+		void	copyBorder(Direction side, const VoxelChunk& neighbour);
+		void	buildFaceMasks(std::vector<ColumnMask>& faceMasks, i32 bottom = 0, i32 top = Config::chunkHeight) const;
+		void	buildBorderFaceMasks(Direction side, std::vector<ColumnMask>& faceMasks) const;
+		void	generateScalarVertexes();
+		void	generateBitmaskVertexes(const std::vector<ColumnMask>& faceMasks);
+		void	generateGreedyVertexes(const std::vector<ColumnMask>& faceMasks);
 };
 
 }	// namespace vox
\ No newline at end of file
@@ -1,22 +1,38 @@
 #pragma once
 
+#include "FrameBudget.hpp"
+#include "Stopwatch.hpp"
 #include "ThreadManager.hpp"
 #include "Vectors.hpp"
 #include "VoxelChunk.hpp"
 #include "World.hpp"
 
+#include <atomic>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
 namespace vox {
 
 using ui8 = uint8_t;
 using i32 = int32_t;
 using ui32 = uint32_t;
 
-enum class Direction : ui8
+/*	Progress of a move of the map window, built on the thread pool while the render loop keeps drawing the current map. */
+
+enum class StreamState : ui8
+{
+	Streaming,	// chunks are generated and meshed, the finished ones are swapped in every frame
+	Ready		// every job is done, the next update finishes the move
+};
+
+enum class StreamTask : ui8
 {
-	North,
-	East,
-	South,
-	West
+	Generate,	// generate the voxels of a new chunk
+	Mesh,		// mesh a new chunk, once it and its new neighbours are generated
+	Border		// rebuild the borders of a kept chunk facing new ones, once those are generated
 };
 
 class VoxelMap
@@ -24,46 +40,188 @@ class VoxelMap
 	public:
 
 		VoxelMap() = delete;
-		VoxelMap(ThreadManager& threadManager);
-		~VoxelMap() = default;
+		VoxelMap(ThreadManager& threadManager, i32 viewDistance = Config::minimumViewingDistance / Config::chunkLength, ui64 memoryBudget = 0);
+		~VoxelMap();
 		VoxelMap(VoxelMap const&) = delete;
 		VoxelMap(VoxelMap&&) = delete;
 		VoxelMap& operator=(VoxelMap const&) = delete;
 		VoxelMap& operator=(VoxelMap&&) = delete;
 
-		bool	update(const vec3& newPosition);
+		bool	update(const vec3& newPosition, const vec3& viewDirection);
 		void	init();
 		vec3	getMapMiddle() const noexcept;
-		std::unique_ptr<ve::VulkanModel> createNewModel( ve::VulkanDevice& device );
+
+		/*	View distance in chunks from the chunk of the player, applied by the next update(s). */
+
+		void	setViewDistance(i32 chunks);
+		i32		getViewDistance() const noexcept { return requestedRadius; }
+		size_t	memoryUsage() const noexcept;
+
+		/*	Chunks found in (hits) or missing from (misses) the cache of evicted chunks when they re-enter the map. */
+
+		struct CacheStats
+		{
+			ui64	hits;
+			ui64	misses;
+			size_t	chunks;
+		};
+
+		CacheStats	cacheStats() const noexcept { return CacheStats{cacheHits, cacheMisses, cacheOrder.size()}; }
+		void	uploadMeshes(ve::VulkanVertexArena& arena, ve::VulkanQuadIndexBuffer& quadIndexes, FrameBudget& budget);
+		void	draw(VkCommandBuffer commandBuffer) const;
 
 		private:
 
-		std::vector<VoxelChunk>	map;
+		using ChunkPtr = std::shared_ptr<VoxelChunk>;
+
+		/*	What the player sees, used to run the most urgent jobs of a step first. */
+
+		struct StreamView
+		{
+			vec3	position;
+			vec3	forward;	// horizontal view direction, normalized
+			vec3	travel;		// horizontal direction of the last move, normalized or zero
+		};
+
+		struct StreamJob
+		{
+			StreamTask	task;
+			i32			slot;
+			vec2i		location;
+		};
+
+		/*	A move of the window to the chunk of the player. The chunks entering the window (or changing level of detail)
+			are new objects, the others stay in their slot. A new chunk meshes as soon as it and its new
+			neighbours are generated and is swapped in once its mesh is uploaded, the kept chunks rebuild their
+			borders meanwhile and are only handed back to the render loop when the whole step is Ready.
+			Pool jobs don't carry a task: each one runs the most urgent ready job when it starts. */
+
+		struct StreamStep
+		{
+			vec2i					minPositions;
+			vec2i					playerOnChunk;
+			std::vector<ChunkPtr>	incoming;	// by slot, nullptr for the slots that keep their chunk
+			i32						incomingCount;
+			i32						prefetchedCount;	// incoming chunks taken from the prefetched ones
+			i32						cachedCount;		// incoming chunks taken from the cache
+			std::vector<i32>		vacated;	// slots left empty by the move, cleared when the step ends
+			std::vector<ui8>		borderSides;	// by slot, bit d set when the kept chunk rebuilds its side Direction(d)
+			std::vector<std::atomic<i32>>	blockers;	// by slot, generations left before its Mesh or Border job
+			std::vector<ui8>		cancelled;	// by slot, the JobCancel of a new chunk that left the view meanwhile
+			std::atomic<i32>		cancelledCount;
+			ui32					epoch;		// of the map when the step was planned
+			std::atomic<i32>		pending;	// Mesh and Border jobs left
+			std::atomic<StreamState>	state;
+			Stopwatch				timer;
+
+			std::mutex				queueMutex;	// guards the members below
+			StreamView				view;
+			std::vector<StreamJob>	ready;
+			std::vector<i32>		finished;	// slots of new chunks meshed since the last uploadMeshes
+		};
+
+		/*	Jobs for chunks that left the view of the player since their step was planned are dropped
+			before they start. A new chunk that is never generated, or never meshed, is not swapped in. */
+
+		enum JobCancel : ui8
+		{
+			NotCancelled,
+			NotGenerated,	// the incoming chunk is empty
+			NotMeshed		// the incoming chunk is generated, it goes to the cache
+		};
+
+		/*	A chunk generated ahead of the view. It is resident but not drawn, a step that brings its
+			location into view takes it over instead of generating it again. */
+
+		struct Prefetch
+		{
+			ChunkPtr			chunk;
+			std::atomic<bool>	generated{false};
+			std::atomic<bool>	dropped{false};	// fell behind before its job started, which then skips it
+			std::shared_ptr<TaskHandle>	task;	// background job, raised once the view is about to reach it
+		};
+
+		/*	Chunk (x, z) lives in slot (x mod squareSize, z mod squareSize): moving the window only replaces
+			the slots of the chunks that leave it, and the neighbours of a chunk are found from its location.
+			The slots outside the view shape around the player are empty. */
+
+		std::vector<ChunkPtr>	map;
+		std::shared_ptr<StreamStep>	stream;
+		std::unordered_map<ui64, std::shared_ptr<Prefetch>>	prefetched;	// by locationKey
+
+		/*	Chunks evicted from the map with their voxels, most recent first. They come back without being
+			generated again, but still mesh against their new neighbours. A location can be cached at
+			several levels of detail, the rings of levels move with the player. */
+
+		std::list<ChunkPtr>	cacheOrder;
+		std::array<std::unordered_map<ui64, std::list<ChunkPtr>::iterator>, Config::lodDistances.size() + 1>	cache;	// by level of detail, then locationKey
+		ui64	cacheHits;
+		ui64	cacheMisses;
 		ui32	worldSeed;
 
 		i32 	squareSize;
+		i32		viewRadius;
+		i32		requestedRadius;
+		ui64	memoryBudget;		// bytes of voxels and meshes, 0 for no limit
+		size_t	averageMeshBytes;	// per chunk, measured whenever no step is streaming
 		vec2i	minPositions;
 		vec2i	maxPositions;
 		vec2i	playerOnChunk;
 		vec3	rawPosition;
+		vec3	travelDirection;
+		vec3	velocity;		// horizontal, in voxels per second, smoothed over a few updates
+		std::atomic<ui32>	epoch;	// bumped whenever the player enters another chunk
+		std::atomic<bool>	closing;	// set by the destructor, every job left is cancelled
+		vec2i	epochChunk;		// chunk of the player at the last bump
+		bool	mapComplete;	// false after a step with cancelled jobs, until a step fills the holes
+		Time	lastUpdate;
 		
-		VertexVector	modelVector;
-		IndexVector		modelIndexes;
+		/*	Meshes replaced or dropped from the map, kept alive until no frame in flight can still draw them. */
+
+		struct RetiredMesh
+		{
+			ui64								frame;
+			std::unique_ptr<ve::VulkanModel>	mesh;
+		};
+
+		std::deque<RetiredMesh>	retiredMeshes;
+		std::vector<ChunkPtr>	pendingUploads;	// chunks handed back by the pool with a new mesh
+		std::vector<i32>		pendingInstalls;	// slots of the step meshed but not swapped in yet
+		ui64	uploadFrame;
 		
 		ThreadManager&	threadManager;
-
-		void	north();
-		void	south();
-		void	west();
-		void	east();
+		TaskGroup		poolTasks;	// step and prefetch jobs, which outlive the calls that enqueue them
 
 		vec2i	voxelToChunkPosition(const vec3& position) const noexcept;
-		void	generateRow(i32 index);
-		void	generateColumn(i32 index);
+		i32		slotOf(const vec2i& location) const noexcept;
+		const VoxelChunk*	chunkAt(const vec2i& location, const StreamStep* step = nullptr) const noexcept;
+		Neighbours			neighboursOf(const vec2i& location, const StreamStep* step = nullptr) const noexcept;
+		static bool	insideShape(i32 dx, i32 dz, i32 radius) noexcept;
+		static i32	visibleChunkCount(i32 radius) noexcept;
+		bool	inView(const vec2i& location, const vec2i& centre) const noexcept;
+		i32		budgetDistance(i32 chunks) const noexcept;
+		void	checkMemoryBudget();
+		void	resize(i32 radius, const StreamView& view);
+		ui8		lodFor(const vec2i& chunkLocation, const vec2i& centre) const noexcept;
+
+		float	streamPriority(const StreamJob& job, const StreamView& view) const noexcept;
+
+		void	startStep(const vec2i& offset, const StreamView& view);
+		void	pushJobs(const std::shared_ptr<StreamStep>& step, const std::vector<StreamJob>& jobs);
+		void	runStepJob(const std::shared_ptr<StreamStep>& step);
+		void	releaseSlot(StreamStep& step, i32 slot, std::vector<StreamJob>& unblocked);
+		bool	isStale(const StreamStep& step, const StreamJob& job) const noexcept;
+		void	finishJob(StreamStep& step) noexcept;
+		size_t	uploadChunk(VoxelChunk& chunk, ve::VulkanVertexArena& arena, ve::VulkanQuadIndexBuffer& quadIndexes);
+		void	finishStep();
+
+		static ui64	locationKey(const vec2i& location) noexcept;
+		void	prefetch();
+		ChunkPtr	takePrefetched(const vec2i& location, ui8 level);
+		void		evict(ChunkPtr chunk);
+		ChunkPtr	takeCached(const vec2i& location, ui8 level);
 
-		void	meshRow(i32 index);
-		void	meshColumn(i32 index);
-		void	setAdjacentPointers();
+		void	meshChunks();
 };
 
 }	// namespace vox
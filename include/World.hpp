@@ -48,42 +48,89 @@ enum class VertexFaces : size_t
 	BOTTOM = 20
 };
 
-static constexpr float W = 1.0f / 4.0f;  // width of a tile
-static constexpr float H = 1.0f / 3.0f;  // height of a tile
-static constexpr float padding = 0.004f;
+/*
+* Terrain vertexes are packed in 8 bytes (TerrainVertex), decoded by shaders/basic.vert:
+* word 0:	bits 0-4 x, bits 5-13 y, bits 14-18 z: corner of the face inside the chunk (0 to chunk size inclusive)
+*			bits 19-21 face (VertexFaces / 4), bits 22-29 voxel type
+* word 1:	bits 0-15 chunk x, bits 16-31 chunk z (signed)
+*
+* The normal follows from the face, and the texture coordinates are the chunk-local position projected on
+* the face, so a merged (greedy) face repeats the atlas tile once per voxel instead of stretching it.
+*/
+inline constexpr ui32	PACKED_X_BITS = 5U;
+inline constexpr ui32	PACKED_Y_BITS = 9U;
+inline constexpr ui32	PACKED_Z_BITS = 5U;
+inline constexpr ui32	PACKED_FACE_BITS = 3U;
+
+static_assert(Config::chunkLength < (1 << PACKED_X_BITS) && Config::chunkLength < (1 << PACKED_Z_BITS), "chunk length does not fit in a packed vertex");
+static_assert(Config::chunkHeight < (1 << PACKED_Y_BITS), "chunk height does not fit in a packed vertex");
+
+inline constexpr ui32	packVertexPosition(const vec3i& local, size_t faceIndex, VoxelType type) noexcept
+{
+	ui32 word = static_cast<ui32>(local.x);
+	ui32 shift = PACKED_X_BITS;
+
+	word |= static_cast<ui32>(local.y) << shift;
+	shift += PACKED_Y_BITS;
+	word |= static_cast<ui32>(local.z) << shift;
+	shift += PACKED_Z_BITS;
+	word |= static_cast<ui32>(faceIndex / 4) << shift;
+	shift += PACKED_FACE_BITS;
+	return word | static_cast<ui32>(type) << shift;
+}
+
+inline constexpr vec3i	unpackVertexPosition(ui32 word) noexcept
+{
+	return vec3i
+	{
+		static_cast<i32>(word & ((1U << PACKED_X_BITS) - 1)),
+		static_cast<i32>((word >> PACKED_X_BITS) & ((1U << PACKED_Y_BITS) - 1)),
+		static_cast<i32>((word >> (PACKED_X_BITS + PACKED_Y_BITS)) & ((1U << PACKED_Z_BITS) - 1))
+	};
+}
+
+inline constexpr size_t	unpackVertexFace(ui32 word) noexcept
+{
+	return ((word >> (PACKED_X_BITS + PACKED_Y_BITS + PACKED_Z_BITS)) & ((1U << PACKED_FACE_BITS) - 1)) * 4;
+}
+
+inline constexpr ui32	packChunkLocation(const vec2i& location) noexcept
+{
+	return (static_cast<ui32>(location.x) & 0xFFFFU) | (static_cast<ui32>(location.y) << 16);
+}
 
 // Hard-coded VBO (vertex+normal+textureUV data) of a voxel
 inline constexpr std::array<ve::VulkanModel::Vertex,VERTEX_PER_VOXEL> VOXEL_VERTEXES{
 	// face FRONT (z = +0.5)
-	ve::VulkanModel::Vertex{vec3{ -0.5f, -0.5f,  0.5f }, vec3::forward(), vec2{ W + padding, 3 * H - padding }},
-	ve::VulkanModel::Vertex{vec3{  0.5f, -0.5f,  0.5f }, vec3::forward(), vec2{ 2 * W - padding, 3 * H - padding }},
-	ve::VulkanModel::Vertex{vec3{  0.5f,  0.5f,  0.5f }, vec3::forward(), vec2{ 2 * W - padding, 2 * H + padding }},
-	ve::VulkanModel::Vertex{vec3{ -0.5f,  0.5f,  0.5f }, vec3::forward(), vec2{ W + padding, 2 * H + padding }},
+	ve::VulkanModel::Vertex{vec3{ -0.5f, -0.5f,  0.5f }, vec3::forward(), vec2{ 0.0f, 1.0f }},
+	ve::VulkanModel::Vertex{vec3{  0.5f, -0.5f,  0.5f }, vec3::forward(), vec2{ 1.0f, 1.0f }},
+	ve::VulkanModel::Vertex{vec3{  0.5f,  0.5f,  0.5f }, vec3::forward(), vec2{ 1.0f, 0.0f }},
+	ve::VulkanModel::Vertex{vec3{ -0.5f,  0.5f,  0.5f }, vec3::forward(), vec2{ 0.0f, 0.0f }},
 	//face BACK (z = -0.5)
-	ve::VulkanModel::Vertex{vec3{  0.5f, -0.5f, -0.5f }, vec3::backward(), vec2{ 2 * W - padding, padding }},
-	ve::VulkanModel::Vertex{vec3{ -0.5f, -0.5f, -0.5f }, vec3::backward(), vec2{ W + padding, padding }},
-	ve::VulkanModel::Vertex{vec3{ -0.5f,  0.5f, -0.5f }, vec3::backward(), vec2{ W + padding, H - padding }},
-	ve::VulkanModel::Vertex{vec3{  0.5f,  0.5f, -0.5f }, vec3::backward(), vec2{ 2 * W - padding, H - padding }},
+	ve::VulkanModel::Vertex{vec3{  0.5f, -0.5f, -0.5f }, vec3::backward(), vec2{ 1.0f, 0.0f }},
+	ve::VulkanModel::Vertex{vec3{ -0.5f, -0.5f, -0.5f }, vec3::backward(), vec2{ 0.0f, 0.0f }},
+	ve::VulkanModel::Vertex{vec3{ -0.5f,  0.5f, -0.5f }, vec3::backward(), vec2{ 0.0f, 1.0f }},
+	ve::VulkanModel::Vertex{vec3{  0.5f,  0.5f, -0.5f }, vec3::backward(), vec2{ 1.0f, 1.0f }},
 	// face LEFT (x = -0.5)
-	ve::VulkanModel::Vertex{vec3{ -0.5f, -0.5f, -0.5f }, vec3::left(), vec2{ padding, H + padding }},
-	ve::VulkanModel::Vertex{vec3{ -0.5f, -0.5f,  0.5f }, vec3::left(), vec2{ padding, 2 * H - padding }},
-	ve::VulkanModel::Vertex{vec3{ -0.5f,  0.5f,  0.5f }, vec3::left(), vec2{ W - padding, 2 * H - padding }},
-	ve::VulkanModel::Vertex{vec3{ -0.5f,  0.5f, -0.5f }, vec3::left(), vec2{ W - padding, H + padding }},
+	ve::VulkanModel::Vertex{vec3{ -0.5f, -0.5f, -0.5f }, vec3::left(), vec2{ 0.0f, 0.0f }},
+	ve::VulkanModel::Vertex{vec3{ -0.5f, -0.5f,  0.5f }, vec3::left(), vec2{ 0.0f, 1.0f }},
+	ve::VulkanModel::Vertex{vec3{ -0.5f,  0.5f,  0.5f }, vec3::left(), vec2{ 1.0f, 1.0f }},
+	ve::VulkanModel::Vertex{vec3{ -0.5f,  0.5f, -0.5f }, vec3::left(), vec2{ 1.0f, 0.0f }},
 	// face RIGHT (x = +0.5)
-	ve::VulkanModel::Vertex{vec3{  0.5f, -0.5f,  0.5f }, vec3::right(), vec2{ 3 * W - padding, 2 * H - padding }},
-	ve::VulkanModel::Vertex{vec3{  0.5f, -0.5f, -0.5f }, vec3::right(), vec2{ 3 * W - padding, H + padding }},
-	ve::VulkanModel::Vertex{vec3{  0.5f,  0.5f, -0.5f }, vec3::right(), vec2{ 2 * W + padding, H + padding }},
-	ve::VulkanModel::Vertex{vec3{  0.5f,  0.5f,  0.5f }, vec3::right(), vec2{ 2 * W + padding, 2 * H - padding }},
+	ve::VulkanModel::Vertex{vec3{  0.5f, -0.5f,  0.5f }, vec3::right(), vec2{ 1.0f, 1.0f }},
+	ve::VulkanModel::Vertex{vec3{  0.5f, -0.5f, -0.5f }, vec3::right(), vec2{ 1.0f, 0.0f }},
+	ve::VulkanModel::Vertex{vec3{  0.5f,  0.5f, -0.5f }, vec3::right(), vec2{ 0.0f, 0.0f }},
+	ve::VulkanModel::Vertex{vec3{  0.5f,  0.5f,  0.5f }, vec3::right(), vec2{ 0.0f, 1.0f }},
 	// face TOP (y = +0.5)
-	ve::VulkanModel::Vertex{vec3{ -0.5f,  0.5f,  0.5f }, vec3::up(), vec2{ W + padding, 2 * H - padding }},
-	ve::VulkanModel::Vertex{vec3{  0.5f,  0.5f,  0.5f }, vec3::up(), vec2{ 2 * W - padding, 2 * H - padding }},
-	ve::VulkanModel::Vertex{vec3{  0.5f,  0.5f, -0.5f }, vec3::up(), vec2{ 2 * W - padding, H + padding }},
-	ve::VulkanModel::Vertex{vec3{ -0.5f,  0.5f, -0.5f }, vec3::up(), vec2{ W + padding, H + padding }},
+	ve::VulkanModel::Vertex{vec3{ -0.5f,  0.5f,  0.5f }, vec3::up(), vec2{ 0.0f, 1.0f }},
+	ve::VulkanModel::Vertex{vec3{  0.5f,  0.5f,  0.5f }, vec3::up(), vec2{ 1.0f, 1.0f }},
+	ve::VulkanModel::Vertex{vec3{  0.5f,  0.5f, -0.5f }, vec3::up(), vec2{ 1.0f, 0.0f }},
+	ve::VulkanModel::Vertex{vec3{ -0.5f,  0.5f, -0.5f }, vec3::up(), vec2{ 0.0f, 0.0f }},
 	// face BOTTOM (y = -0.5)
-	ve::VulkanModel::Vertex{vec3{ -0.5f, -0.5f, -0.5f }, vec3::down(), vec2{ 3 * W + padding, H + padding }},
-	ve::VulkanModel::Vertex{vec3{  0.5f, -0.5f, -0.5f }, vec3::down(), vec2{ 3 * W + padding, 2 * H - padding }},
-	ve::VulkanModel::Vertex{vec3{  0.5f, -0.5f,  0.5f }, vec3::down(), vec2{ 4 * W - padding, 2 * H - padding }},
-	ve::VulkanModel::Vertex{vec3{ -0.5f, -0.5f,  0.5f }, vec3::down(), vec2{ 4 * W - padding, H + padding }}
+	ve::VulkanModel::Vertex{vec3{ -0.5f, -0.5f, -0.5f }, vec3::down(), vec2{ 0.0f, 0.0f }},
+	ve::VulkanModel::Vertex{vec3{  0.5f, -0.5f, -0.5f }, vec3::down(), vec2{ 0.0f, 1.0f }},
+	ve::VulkanModel::Vertex{vec3{  0.5f, -0.5f,  0.5f }, vec3::down(), vec2{ 1.0f, 1.0f }},
+	ve::VulkanModel::Vertex{vec3{ -0.5f, -0.5f,  0.5f }, vec3::down(), vec2{ 1.0f, 0.0f }}
 };
 
 // hard-coded face indexes of a voxel
@@ -109,11 +156,10 @@ inline constexpr std::array<ui32, 6> rightFaceIndexes{12U, 13U, 14U, 12U, 14U, 1
 inline constexpr std::array<ui32, 6> topFaceIndexes{16U, 17U, 18U, 16U, 18U, 19U};
 inline constexpr std::array<ui32, 6> bottomFaceIndexes{20U, 21U, 22U, 20U, 22U, 23U};
 
-using VertexVector = std::vector<ve::VulkanModel::Vertex>;
 using IndexVector = std::vector<ui32>;
 
-void	addVoxelFace(const vec3& voxelLocation, VertexVector& chunk, size_t faceIndex);
-void	addVertexes(const vec3& position, VertexVector& chunk, int facesToAdd);
+void	addVoxelFace(const vec3i& location, VertexVector& chunk, size_t faceIndex, VoxelType type, ui32 chunkLocation, const vec3i& size = vec3i{1});
+void	addVertexes(const vec3i& location, VertexVector& chunk, int facesToAdd, VoxelType type, ui32 chunkLocation);
 
 std::vector<vec3>	getVertexRelative( vec3 const& relativeOrigin );
 IndexVector			getIndexRelative( ui32 = 0U );
@@ -12,6 +12,8 @@
 #include "VulkanBuffer.hpp"
 #include "VulkanDescriptors.hpp"
 #include "VulkanModel.hpp"
+#include "VulkanQuadIndexBuffer.hpp"
+#include "VulkanVertexArena.hpp"
 #include "VulkanObject.hpp"
 #include "VulkanRenderer.hpp"
 #include "VulkanTexture.hpp"
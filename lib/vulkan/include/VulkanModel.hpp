@@ -2,7 +2,9 @@
 
 #include "VulkanBuffer.hpp"
 #include "VulkanDevice.hpp"
+#include "VulkanQuadIndexBuffer.hpp"
 #include "VulkanUtils.hpp"
+#include "VulkanVertexArena.hpp"
 
 #include <memory>
 #include <unordered_map>
@@ -23,7 +25,8 @@ enum class ModelLayout : uint32_t {
 	UNSET = 0,
 	VERTEX = 1 << 0,
 	NORMAL = 1 << 1,
-	TEXTURE = 1 << 2
+	TEXTURE = 1 << 2,
+	PACKED = 1 << 3		// one PackedVertex per vertex, decoded by the vertex shader
 };
 
 constexpr ModelLayout operator|(ModelLayout a, ModelLayout b) {
@@ -72,6 +75,16 @@ class VulkanModel
 		}
 	};
 
+	/*	8 byte vertex handed to the shader as a uvec2, the meaning of the bits is up to the caller
+		and its vertex shader. */
+
+	struct PackedVertex
+	{
+		uint32_t	words[2];
+
+		bool operator==(const PackedVertex& other) const noexcept = default;
+	};
+
 	struct Builder
 	{
 		public:
@@ -86,8 +99,9 @@ class VulkanModel
 	VulkanModel(VulkanDevice& device, const Builder& builder, uint32_t binding = 0U, ModelLayout = DEFAULT_MODEL_LAYOUT);
 	VulkanModel(VulkanDevice& device, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, uint32_t binding = 0U, ModelLayout = DEFAULT_MODEL_LAYOUT);
 	VulkanModel(VulkanDevice& device, const std::vector<vec3>& vertices, const std::vector<uint32_t>& indices, uint32_t binding = 0U, ModelLayout = ModelLayout::VERTEX);
+	VulkanModel(VulkanVertexArena& arena, const std::vector<PackedVertex>& quadVertices, VulkanQuadIndexBuffer& quadIndexes, uint32_t binding = 0U, ModelLayout = ModelLayout::PACKED);
 	VulkanModel(VulkanDevice& device, const std::vector<std::vector<Vertex>>& vertices, const std::array<uint32_t, INDEX_PER_VOXEL>& indexesVoxel, uint32_t binding = 0U, ModelLayout = DEFAULT_MODEL_LAYOUT);
-	~VulkanModel() noexcept = default;
+	~VulkanModel() noexcept;
 
 	VulkanModel(const VulkanModel&) = delete;
 	VulkanModel(VulkanModel&&) = delete;
@@ -99,8 +113,10 @@ class VulkanModel
 	void	setName(const std::string& name) { this->name = name; }
 	void	setBoundingBox(const std::vector<Vertex>& vertices) noexcept;
 
-	std::vector<VkVertexInputBindingDescription>	getBindingDescriptions() const noexcept;
-	std::vector<VkVertexInputAttributeDescription>	getAttributeDescriptions() const noexcept;
+	ModelLayout	getLayout() const noexcept { return type; }
+
+	static std::vector<VkVertexInputBindingDescription>		getBindingDescriptions(ModelLayout layout) noexcept;
+	static std::vector<VkVertexInputAttributeDescription>	getAttributeDescriptions(ModelLayout layout) noexcept;
 
 	const vec3&	getVertexCenter() const noexcept { return vertexCenter; }
 	const vec3&	getBoundingCenter() const noexcept { return boundingCenter; }
@@ -119,6 +135,9 @@ class VulkanModel
 
 	std::unique_ptr<VulkanBuffer>	vertexBuffer;
 	std::unique_ptr<VulkanBuffer>	indexBuffer;
+	VulkanQuadIndexBuffer*			quadIndexes = nullptr;
+	VulkanVertexArena*				arena = nullptr;	// owns the vertexes instead of vertexBuffer
+	VulkanVertexArena::Range		arenaRange;
 
 	vec3			vertexCenter;
 	vec3			boundingCenter;
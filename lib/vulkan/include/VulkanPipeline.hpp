@@ -59,7 +59,7 @@ class VulkanPipeline
 			VkRenderPass renderPass,
 			std::string const& vertexShaderFile,
 			std::string const& fragmentShaderFile,
-			VulkanModel const& mesh,
+			ModelLayout layout,
 			bool hasCubemapsTexture
 		);
 		~VulkanPipeline( void );
@@ -76,14 +76,14 @@ class VulkanPipeline
 			VkRenderPass renderPass,
 			std::string const& vertexShaderFile,
 			std::string const& fragmentShaderFile,
-			VulkanModel const& mesh,
+			ModelLayout layout,
 			bool hasCubemapsTexture = false
 		);
 
 	private:
 		void					setupPipelineLayout( std::vector<VkDescriptorSetLayout> const& descriptorSetLayouts );
-		void					setupPipeline( std::string const& vertexShaderFile, std::string const& fragmentShaderFile, VulkanModel const& mesh, bool hasCubemapsTexture, VkRenderPass renderPass );
-		VulkanPipelineConfig	getPipelineConfig( std::vector<VulkanShader> const& shaders, VulkanModel const& mesh, bool hasCubemapsTexture ) const noexcept;
+		void					setupPipeline( std::string const& vertexShaderFile, std::string const& fragmentShaderFile, ModelLayout layout, bool hasCubemapsTexture, VkRenderPass renderPass );
+		VulkanPipelineConfig	getPipelineConfig( std::vector<VulkanShader> const& shaders, ModelLayout layout, bool hasCubemapsTexture ) const noexcept;
 
 		VulkanDevice&		vulkanDevice;
 		VkPipelineLayout	pipelineLayout;
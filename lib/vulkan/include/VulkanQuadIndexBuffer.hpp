@@ -0,0 +1,53 @@
+#pragma once
+
+#include "VulkanBuffer.hpp"
+#include "VulkanDevice.hpp"
+
+#include <memory>
+
+
+namespace ve {
+
+/*	Index buffer shared by every mesh made of quads (4 vertexes per quad, drawn as 0,1,2 0,2,3).
+	The pattern never changes, so it is uploaded once and only rebuilt when a bigger mesh shows up.
+	Meshes of at most MAX_SHORT_QUADS quads use the fixed 16 bit buffer, several of them can share
+	it by drawing with their own vertexOffset. */
+
+class VulkanQuadIndexBuffer
+{
+	public:
+
+	static constexpr uint32_t	VERTEX_PER_QUAD = 4U;
+	static constexpr uint32_t	INDEX_PER_QUAD = 6U;
+	static constexpr uint32_t	MAX_SHORT_QUADS = 16384U;	// 65536 vertexes, the range of a 16 bit index
+
+	VulkanQuadIndexBuffer() = delete;
+	VulkanQuadIndexBuffer(VulkanDevice& device, uint32_t quadCount = 0U);
+	~VulkanQuadIndexBuffer() noexcept = default;
+
+	VulkanQuadIndexBuffer(const VulkanQuadIndexBuffer&) = delete;
+	VulkanQuadIndexBuffer(VulkanQuadIndexBuffer&&) = delete;
+	VulkanQuadIndexBuffer& operator=(const VulkanQuadIndexBuffer&) = delete;
+	VulkanQuadIndexBuffer& operator=(VulkanQuadIndexBuffer&&) = delete;
+
+	void	reserve(uint32_t quadCount);
+	void	bind(VkCommandBuffer commandBuffer, uint32_t quadCount) const;
+	void	draw(VkCommandBuffer commandBuffer, uint32_t quadCount, int32_t vertexOffset = 0) const;
+
+	uint32_t	getCapacity() const noexcept { return capacity; }
+
+	static bool	usesShortIndexes(uint32_t quadCount) noexcept { return quadCount <= MAX_SHORT_QUADS; }
+
+	private:
+
+	VulkanDevice&	vulkanDevice;
+	uint32_t		capacity;
+
+	std::unique_ptr<VulkanBuffer>	shortIndexBuffer;
+	std::unique_ptr<VulkanBuffer>	indexBuffer;
+
+	template<typename IndexType>
+	std::unique_ptr<VulkanBuffer>	createIndexBuffer(uint32_t quadCount);
+};
+
+}	// namespace ve
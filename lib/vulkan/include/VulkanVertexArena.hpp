@@ -0,0 +1,88 @@
+#pragma once
+
+#include "VulkanBuffer.hpp"
+#include "VulkanDevice.hpp"
+#include "VulkanSwapChain.hpp"
+
+#include <array>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace ve {
+
+/*	Device memory shared by many small vertex buffers, like the meshes of the chunks. Memory is taken
+	from the driver in big blocks and handed out in ranges, so thousands of meshes only use a handful of
+	allocations (drivers cap them, commonly at 4096). Uploads are staged and recorded into one command
+	buffer per frame, submitted with a fence by submitUploads instead of waiting for the queue. */
+
+class VulkanVertexArena
+{
+	public:
+
+	static constexpr VkDeviceSize	DEFAULT_BLOCK_SIZE = 64ULL << 20;
+	static constexpr VkDeviceSize	DEFAULT_STAGING_SIZE = 16ULL << 20;
+	static constexpr VkDeviceSize	RANGE_ALIGNMENT = 16;
+
+	struct Range
+	{
+		VkBuffer		buffer = VK_NULL_HANDLE;
+		VkDeviceSize	offset = 0;
+		VkDeviceSize	size = 0;
+		uint32_t		block = 0;
+	};
+
+	VulkanVertexArena(VulkanDevice& device, VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE, VkDeviceSize stagingSize = DEFAULT_STAGING_SIZE);
+	~VulkanVertexArena();
+
+	VulkanVertexArena() = delete;
+	VulkanVertexArena(const VulkanVertexArena&) = delete;
+	VulkanVertexArena(VulkanVertexArena&&) = delete;
+	VulkanVertexArena& operator=(const VulkanVertexArena&) = delete;
+	VulkanVertexArena& operator=(VulkanVertexArena&&) = delete;
+
+	Range	allocate(VkDeviceSize size);
+	void	free(const Range& range) noexcept;
+	void	upload(const Range& range, const void* data, VkDeviceSize size);
+	void	submitUploads();
+
+	VulkanDevice&	getDevice() const noexcept { return vulkanDevice; }
+
+	private:
+
+	struct Block
+	{
+		std::unique_ptr<VulkanBuffer>			buffer;
+		std::map<VkDeviceSize, VkDeviceSize>	freeRanges;	// offset -> size, never adjacent
+	};
+
+	/*	Staging memory and command buffer of the uploads of one frame, reused once its fence signals. */
+
+	struct Batch
+	{
+		std::vector<std::unique_ptr<VulkanBuffer>>	stagingPages;
+		size_t			page = 0;
+		VkDeviceSize	pageUsed = 0;
+		VkCommandBuffer	commandBuffer = VK_NULL_HANDLE;
+		VkFence			fence = VK_NULL_HANDLE;
+		bool			recording = false;
+	};
+
+	VulkanDevice&	vulkanDevice;
+	VkDeviceSize	blockSize;
+	VkDeviceSize	stagingSize;
+	VkDeviceSize	usedBytes;		// by the ranges handed out, under blocksMutex
+
+	std::mutex			blocksMutex;	// meshes may be released from any thread
+	std::vector<Block>	blocks;
+
+	std::array<Batch, VulkanSwapChain::MAX_FRAMES_IN_FLIGHT>	batches;
+	size_t	currentBatch;
+
+	Batch&	openBatch();
+	void	addBlock(VkDeviceSize size);
+};
+
+}	// namespace ve
@@ -30,6 +30,31 @@ VulkanModel::VulkanModel(VulkanDevice& device, const std::vector<vec3>& vertices
 		createIndexBuffers(indices);
 }
 
+/**
+ * Load a mesh made of quads, every 4 vertexes form one quad. The indexes come from the shared
+ * quad index buffer instead of being uploaded with every mesh. The vertexes live in a range of the
+ * arena, their upload is recorded with the other uploads of the frame and submitted by the arena
+ *
+ * @param arena shared vertex memory, the range goes back to it when the model is destroyed
+ * @param quadIndexes shared index buffer, grown here if the mesh needs more quads than it holds
+ */
+
+VulkanModel::VulkanModel(VulkanVertexArena& arena, const std::vector<PackedVertex>& quadVertices, VulkanQuadIndexBuffer& quadIndexes, uint32_t binding, ModelLayout type) :
+	vulkanDevice{arena.getDevice()}, binding{binding}, type{type}, quadIndexes{&quadIndexes}, arena{&arena}
+{
+	assert(quadVertices.size() % VulkanQuadIndexBuffer::VERTEX_PER_QUAD == 0 && "Quad vertexes must come in groups of 4");
+	vertexCount = static_cast<uint32_t>(quadVertices.size());
+	assert(vertexCount >= 3 && "Vertex count must be at least 3");
+
+	const VkDeviceSize	bufferSize = sizeof(PackedVertex) * static_cast<VkDeviceSize>(vertexCount);
+
+	arenaRange = arena.allocate(bufferSize);
+	arena.upload(arenaRange, quadVertices.data(), bufferSize);
+	indexCount = vertexCount / VulkanQuadIndexBuffer::VERTEX_PER_QUAD * VulkanQuadIndexBuffer::INDEX_PER_QUAD;
+	isIndexed = true;
+	quadIndexes.reserve(vertexCount / VulkanQuadIndexBuffer::VERTEX_PER_QUAD);
+}
+
 /**
  * Load data in GPU, combining together the 
  * chunks of vertexes and building indexed data on the spot
@@ -213,13 +238,25 @@ void	VulkanModel::createVertexIndexBuffers(const std::vector<std::vector<Vertex>
 	vulkanDevice.copyBuffer(stagingBufferIndex.getBuffer(), indexBuffer->getBuffer(), this->indexCount * indexSize);
 }
 
+VulkanModel::~VulkanModel() noexcept
+{
+	if (arena != nullptr)
+	{
+		arena->free(arenaRange);
+	}
+}
+
 void	VulkanModel::bind(VkCommandBuffer commandBuffer)
 {
-	VkBuffer		buffers[] = {vertexBuffer->getBuffer()};
-	VkDeviceSize	offsets[] = {0};
+	VkBuffer		buffers[] = {arena != nullptr ? arenaRange.buffer : vertexBuffer->getBuffer()};
+	VkDeviceSize	offsets[] = {arena != nullptr ? arenaRange.offset : 0};
 
 	vkCmdBindVertexBuffers(commandBuffer, binding, 1, buffers, offsets);
-	if (this->isIndexed == true)
+	if (this->quadIndexes != nullptr)
+	{
+		this->quadIndexes->bind(commandBuffer, vertexCount / VulkanQuadIndexBuffer::VERTEX_PER_QUAD);
+	}
+	else if (this->isIndexed == true)
 	{
 		vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
 	}
@@ -227,7 +264,11 @@ void	VulkanModel::bind(VkCommandBuffer commandBuffer)
 
 void	VulkanModel::draw(VkCommandBuffer commandBuffer)
 {
-	if (this->isIndexed == true)
+	if (this->quadIndexes != nullptr)
+	{
+		this->quadIndexes->draw(commandBuffer, vertexCount / VulkanQuadIndexBuffer::VERTEX_PER_QUAD);
+	}
+	else if (this->isIndexed == true)
 	{
 		vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
 	}
@@ -253,34 +294,40 @@ void	VulkanModel::setBoundingBox(const std::vector<Vertex>& vertices) noexcept
 		[](const Vertex& a, const Vertex& b) { return a.pos.z < b.pos.z; })->pos.z;
 }
 
-std::vector<VkVertexInputBindingDescription>	VulkanModel::getBindingDescriptions() const noexcept
+std::vector<VkVertexInputBindingDescription>	VulkanModel::getBindingDescriptions(ModelLayout layout) noexcept
 {
 	std::vector<VkVertexInputBindingDescription>	bindingDescriptions(1);
 
 	bindingDescriptions[0].binding = 0;
 	bindingDescriptions[0].stride = 0;
-	if (this->type & ModelLayout::VERTEX)
+	if (layout & ModelLayout::PACKED)
+		bindingDescriptions[0].stride += sizeof(PackedVertex);
+	if (layout & ModelLayout::VERTEX)
 		bindingDescriptions[0].stride += sizeof(vec3);
-	if (this->type & ModelLayout::NORMAL)
+	if (layout & ModelLayout::NORMAL)
 		bindingDescriptions[0].stride += sizeof(vec3);
-	if (this->type & ModelLayout::TEXTURE)
+	if (layout & ModelLayout::TEXTURE)
 		bindingDescriptions[0].stride += sizeof(vec2);
 	bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 	return bindingDescriptions;
 }
 
-std::vector<VkVertexInputAttributeDescription>	VulkanModel::getAttributeDescriptions() const noexcept
+std::vector<VkVertexInputAttributeDescription>	VulkanModel::getAttributeDescriptions(ModelLayout layout) noexcept
 {
 	std::vector<VkVertexInputAttributeDescription>	attributeDescriptions;
 
-	if (this->type & ModelLayout::VERTEX)
+	if (layout & ModelLayout::PACKED)
+		attributeDescriptions.push_back(
+			VkVertexInputAttributeDescription{0, 0, VK_FORMAT_R32G32_UINT, offsetof(PackedVertex, words)}
+		);
+	if (layout & ModelLayout::VERTEX)
 		attributeDescriptions.push_back(
 			VkVertexInputAttributeDescription{0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, pos)});
-	if (this->type & ModelLayout::NORMAL)
+	if (layout & ModelLayout::NORMAL)
 		attributeDescriptions.push_back(
 			VkVertexInputAttributeDescription{1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal)}
 		);
-	if (this->type & ModelLayout::TEXTURE)
+	if (layout & ModelLayout::TEXTURE)
 		attributeDescriptions.push_back(
 			VkVertexInputAttributeDescription{2, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, textureUv)}
 		);
@@ -49,7 +49,7 @@ std::unique_ptr<VulkanPipeline> VulkanPipeline::createPipeline(
 	VkRenderPass renderPass,
 	std::string const& vertexShaderFile,
 	std::string const& fragmentShaderFile,
-	VulkanModel const& mesh,
+	ModelLayout layout,
 	bool hasCubemapsTexture
 )
 {
@@ -59,7 +59,7 @@ std::unique_ptr<VulkanPipeline> VulkanPipeline::createPipeline(
 		renderPass,
 		vertexShaderFile,
 		fragmentShaderFile,
-		mesh,
+		layout,
 		hasCubemapsTexture
 	);
 }
@@ -70,13 +70,13 @@ VulkanPipeline::VulkanPipeline(
 		VkRenderPass renderPass,
 		std::string const& vertexShaderFile,
 		std::string const& fragmentShaderFile,
-		VulkanModel const& mesh,
+		ModelLayout layout,
 		bool hasCubemapsTexture
 	) :
 	vulkanDevice{device}
 {
 	this->setupPipelineLayout(descriptorSetLayouts);
-	this->setupPipeline(vertexShaderFile, fragmentShaderFile, mesh, hasCubemapsTexture, renderPass);
+	this->setupPipeline(vertexShaderFile, fragmentShaderFile, layout, hasCubemapsTexture, renderPass);
 }
 
 VulkanPipeline::~VulkanPipeline()
@@ -112,7 +112,7 @@ void VulkanPipeline::setupPipelineLayout(std::vector<VkDescriptorSetLayout> cons
 	}
 }
 
-void VulkanPipeline::setupPipeline(std::string const& vertexShaderFile, std::string const& fragmentShaderFile, VulkanModel const& mesh, bool hasCubemapsTexture, VkRenderPass renderPass)
+void VulkanPipeline::setupPipeline(std::string const& vertexShaderFile, std::string const& fragmentShaderFile, ModelLayout layout, bool hasCubemapsTexture, VkRenderPass renderPass)
 {
 	assert(this->pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
@@ -120,7 +120,7 @@ void VulkanPipeline::setupPipeline(std::string const& vertexShaderFile, std::str
 	shaders.emplace_back(this->vulkanDevice, VK_SHADER_STAGE_VERTEX_BIT, vertexShaderFile);
 	shaders.emplace_back(this->vulkanDevice, VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShaderFile);
 
-	VulkanPipelineConfig pipelineConfig = this->getPipelineConfig(shaders, mesh, hasCubemapsTexture);
+	VulkanPipelineConfig pipelineConfig = this->getPipelineConfig(shaders, layout, hasCubemapsTexture);
 
 	VkGraphicsPipelineCreateInfo pipelineInfo{};
 	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -153,13 +153,13 @@ void VulkanPipeline::setupPipeline(std::string const& vertexShaderFile, std::str
 	}
 }
 
-VulkanPipelineConfig VulkanPipeline::getPipelineConfig( std::vector<VulkanShader> const& shaders, VulkanModel const& mesh, bool hasCubemapsTexture ) const noexcept
+VulkanPipelineConfig VulkanPipeline::getPipelineConfig( std::vector<VulkanShader> const& shaders, ModelLayout layout, bool hasCubemapsTexture ) const noexcept
 {
 	assert(this->pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
 	VulkanPipelineConfig configInfo{};
-	configInfo.bindingVboConfig = mesh.getBindingDescriptions();
-	configInfo.attributeVboConfig = mesh.getAttributeDescriptions();
+	configInfo.bindingVboConfig = VulkanModel::getBindingDescriptions(layout);
+	configInfo.attributeVboConfig = VulkanModel::getAttributeDescriptions(layout);
 	configInfo.vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 	configInfo.vertexInputInfo.pNext = nullptr;
 	configInfo.vertexInputInfo.flags = 0U;
@@ -0,0 +1,108 @@
+#include "VulkanQuadIndexBuffer.hpp"
+
+#include <bit>
+#include <cassert>
+
+
+namespace ve {
+
+VulkanQuadIndexBuffer::VulkanQuadIndexBuffer(VulkanDevice& device, uint32_t quadCount) :
+	vulkanDevice{device}, capacity{0U}
+{
+	shortIndexBuffer = createIndexBuffer<uint16_t>(MAX_SHORT_QUADS);
+	reserve(quadCount);
+}
+
+/**
+ * Make sure the 32 bit buffer holds the indexes of at least quadCount quads. The buffer only grows,
+ * to the next power of two, so a map that keeps roughly the same size never uploads it again.
+ * The old buffer is released after the upload of the new one, which waits for the graphics queue
+ * to be idle, so no frame in flight can still read it
+ *
+ * @param quadCount number of quads the next draw needs
+ */
+
+void	VulkanQuadIndexBuffer::reserve(uint32_t quadCount)
+{
+	if (quadCount <= capacity)
+	{
+		return;
+	}
+	assert(quadCount <= UINT32_MAX / INDEX_PER_QUAD && "Too many quads for a 32 bit index buffer");
+
+	uint32_t	newCapacity = std::bit_ceil(quadCount);
+
+	indexBuffer = createIndexBuffer<uint32_t>(newCapacity);
+	capacity = newCapacity;
+}
+
+/**
+ * Bind the index buffer that fits a mesh of quadCount quads, the 16 bit one whenever possible
+ */
+
+void	VulkanQuadIndexBuffer::bind(VkCommandBuffer commandBuffer, uint32_t quadCount) const
+{
+	if (usesShortIndexes(quadCount) == true)
+	{
+		vkCmdBindIndexBuffer(commandBuffer, shortIndexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT16);
+	}
+	else
+	{
+		assert(quadCount <= capacity && "Quad index buffer too small, call reserve() first");
+		vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+	}
+}
+
+/**
+ * Draw quadCount quads with the index buffer bound by bind()
+ *
+ * @param vertexOffset first vertex of the mesh inside the bound vertex buffer
+ */
+
+void	VulkanQuadIndexBuffer::draw(VkCommandBuffer commandBuffer, uint32_t quadCount, int32_t vertexOffset) const
+{
+	vkCmdDrawIndexed(commandBuffer, quadCount * INDEX_PER_QUAD, 1, 0, vertexOffset, 0);
+}
+
+template<typename IndexType>
+std::unique_ptr<VulkanBuffer>	VulkanQuadIndexBuffer::createIndexBuffer(uint32_t quadCount)
+{
+	uint32_t		indexCount = quadCount * INDEX_PER_QUAD;
+	uint32_t		indexSize = sizeof(IndexType);
+	VkDeviceSize	bufferSize = indexSize * static_cast<VkDeviceSize>(indexCount);
+
+	VulkanBuffer	stagingBuffer(
+		vulkanDevice,
+		indexSize,
+		indexCount,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+	);
+	stagingBuffer.map();
+
+	IndexType*	indexes = static_cast<IndexType*>(stagingBuffer.getMappedMemory());
+
+	for (uint32_t quad = 0; quad < quadCount; quad++)
+	{
+		IndexType	first = static_cast<IndexType>(quad * VERTEX_PER_QUAD);
+
+		*indexes++ = first;
+		*indexes++ = first + 1;
+		*indexes++ = first + 2;
+		*indexes++ = first;
+		*indexes++ = first + 2;
+		*indexes++ = first + 3;
+	}
+
+	std::unique_ptr<VulkanBuffer>	buffer = std::make_unique<VulkanBuffer>(
+		vulkanDevice,
+		indexSize,
+		indexCount,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+	);
+	vulkanDevice.copyBuffer(stagingBuffer.getBuffer(), buffer->getBuffer(), bufferSize);
+	return buffer;
+}
+
+}	// namespace ve
@@ -0,0 +1,249 @@
+#include "VulkanVertexArena.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+
+namespace ve {
+
+static VkDeviceSize	alignUp(VkDeviceSize size, VkDeviceSize alignment) noexcept
+{
+	return (size + alignment - 1) & ~(alignment - 1);
+}
+
+VulkanVertexArena::VulkanVertexArena(VulkanDevice& device, VkDeviceSize blockSize, VkDeviceSize stagingSize) :
+	vulkanDevice{device}, blockSize{blockSize}, stagingSize{stagingSize}, usedBytes{0}, currentBatch{0}
+{
+	for (Batch& batch : batches)
+	{
+		VkCommandBufferAllocateInfo	allocInfo{};
+
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = vulkanDevice.getCommandPool();
+		allocInfo.commandBufferCount = 1;
+		if (vkAllocateCommandBuffers(vulkanDevice.device(), &allocInfo, &batch.commandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to allocate upload command buffer!");
+		}
+
+		VkFenceCreateInfo	fenceInfo{};
+
+		// signaled, the first wait on a batch never used returns at once
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+		if (vkCreateFence(vulkanDevice.device(), &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create upload fence!");
+		}
+	}
+}
+
+VulkanVertexArena::~VulkanVertexArena()
+{
+	for (Batch& batch : batches)
+	{
+		if (batch.recording == true)
+		{
+			vkEndCommandBuffer(batch.commandBuffer);
+		}
+		vkWaitForFences(vulkanDevice.device(), 1, &batch.fence, VK_TRUE, UINT64_MAX);
+		vkDestroyFence(vulkanDevice.device(), batch.fence, nullptr);
+		vkFreeCommandBuffers(vulkanDevice.device(), vulkanDevice.getCommandPool(), 1, &batch.commandBuffer);
+	}
+}
+
+/**
+ * Take a range of at least size bytes from the first block with room for it, a new block is added
+ * when none has. A range bigger than a block gets a block of its own
+ *
+ * @return range to bind as a vertex buffer at its offset, give it back with free()
+ */
+
+VulkanVertexArena::Range	VulkanVertexArena::allocate(VkDeviceSize size)
+{
+	std::lock_guard<std::mutex>	lock(blocksMutex);
+
+	size = alignUp(std::max<VkDeviceSize>(size, 1), RANGE_ALIGNMENT);
+	for (uint32_t index = 0; index <= blocks.size(); index++)
+	{
+		if (index == blocks.size())
+		{
+			addBlock(std::max(blockSize, size));
+		}
+
+		Block&	block = blocks[index];
+
+		for (auto it = block.freeRanges.begin(); it != block.freeRanges.end(); it++)
+		{
+			if (it->second < size)
+			{
+				continue;
+			}
+
+			const Range	range{block.buffer->getBuffer(), it->first, size, index};
+
+			if (it->second > size)
+			{
+				block.freeRanges.emplace(it->first + size, it->second - size);
+			}
+			block.freeRanges.erase(it);
+			usedBytes += size;
+			return range;
+		}
+	}
+	throw std::runtime_error("failed to allocate vertex arena range!");
+}
+
+/**
+ * Give a range back to its block, merged with the free ranges around it. The GPU must be done with
+ * it: meshes are released a few frames after they were last drawn
+ */
+
+void	VulkanVertexArena::free(const Range& range) noexcept
+{
+	std::lock_guard<std::mutex>	lock(blocksMutex);
+	Block&						block = blocks[range.block];
+	VkDeviceSize				offset = range.offset;
+	VkDeviceSize				size = range.size;
+	auto						next = block.freeRanges.lower_bound(offset);
+
+	usedBytes -= range.size;
+	if (next != block.freeRanges.end() && next->first == offset + size)
+	{
+		size += next->second;
+		next = block.freeRanges.erase(next);
+	}
+	if (next != block.freeRanges.begin())
+	{
+		auto previous = std::prev(next);
+
+		if (previous->first + previous->second == offset)
+		{
+			previous->second += size;
+			return;
+		}
+	}
+	block.freeRanges.emplace(offset, size);
+}
+
+/**
+ * Copy data into a staging page of the current frame and record its copy to range. Nothing reaches
+ * the GPU before submitUploads
+ */
+
+void	VulkanVertexArena::upload(const Range& range, const void* data, VkDeviceSize size)
+{
+	assert(size <= range.size && "Upload bigger than its range");
+
+	Batch&	batch = openBatch();
+
+	while (batch.page < batch.stagingPages.size() && batch.pageUsed + size > batch.stagingPages[batch.page]->getBufferSize())
+	{
+		batch.page++;
+		batch.pageUsed = 0;
+	}
+	if (batch.page == batch.stagingPages.size())
+	{
+		batch.stagingPages.push_back(std::make_unique<VulkanBuffer>(
+			vulkanDevice,
+			1,
+			static_cast<uint32_t>(std::max(stagingSize, size)),
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+		));
+		batch.stagingPages.back()->map();
+	}
+
+	VulkanBuffer&	page = *batch.stagingPages[batch.page];
+	VkBufferCopy	copyRegion{};
+
+	page.writeToBuffer(data, size, batch.pageUsed);
+	copyRegion.srcOffset = batch.pageUsed;
+	copyRegion.dstOffset = range.offset;
+	copyRegion.size = size;
+	vkCmdCopyBuffer(batch.commandBuffer, page.getBuffer(), range.buffer, 1, &copyRegion);
+	batch.pageUsed = alignUp(batch.pageUsed + size, RANGE_ALIGNMENT);
+}
+
+/**
+ * Submit the copies recorded since the last call, once per frame before the frame that draws them.
+ * The barrier makes the copies visible to the vertex input of every later submission on the queue,
+ * the fence tells when the staging pages of the batch can be written again
+ */
+
+void	VulkanVertexArena::submitUploads()
+{
+	Batch&	batch = batches[currentBatch];
+
+	if (batch.recording == false)
+	{
+		return;
+	}
+
+	VkMemoryBarrier	barrier{};
+
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+		0, 1, &barrier, 0, nullptr, 0, nullptr);
+	vkEndCommandBuffer(batch.commandBuffer);
+
+	VkSubmitInfo	submitInfo{};
+
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &batch.commandBuffer;
+	if (vkQueueSubmit(vulkanDevice.graphicsQueue(), 1, &submitInfo, batch.fence) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to submit vertex uploads!");
+	}
+	batch.recording = false;
+	currentBatch = (currentBatch + 1) % batches.size();
+}
+
+/*	The batch of the current frame, started on its first upload once the GPU is done with the copies it
+	held MAX_FRAMES_IN_FLIGHT frames ago, which it normally is already. */
+
+VulkanVertexArena::Batch&	VulkanVertexArena::openBatch()
+{
+	Batch&	batch = batches[currentBatch];
+
+	if (batch.recording == true)
+	{
+		return batch;
+	}
+	vkWaitForFences(vulkanDevice.device(), 1, &batch.fence, VK_TRUE, UINT64_MAX);
+	vkResetFences(vulkanDevice.device(), 1, &batch.fence);
+	vkResetCommandBuffer(batch.commandBuffer, 0);
+	batch.page = 0;
+	batch.pageUsed = 0;
+
+	VkCommandBufferBeginInfo	beginInfo{};
+
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+	batch.recording = true;
+	return batch;
+}
+
+void	VulkanVertexArena::addBlock(VkDeviceSize size)
+{
+	Block	block;
+
+	block.buffer = std::make_unique<VulkanBuffer>(
+		vulkanDevice,
+		1,
+		static_cast<uint32_t>(size),
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+	);
+	block.freeRanges.emplace(0, size);
+	blocks.push_back(std::move(block));
+}
+
+}	// namespace ve
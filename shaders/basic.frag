@@ -3,11 +3,40 @@
 layout(set = 1, binding = 0) uniform sampler2D texSampler;
 
 layout(location = 0) in vec2 fragTexCoord;
+layout(location = 1) flat in uint fragFace;
 
 layout(location = 0) out vec4 outColor;
 
+/*
+* The atlas (textures/texture_dirt_atlas.jpeg) is a 4x3 grid of tiles, every face direction
+* uses its own tile:
+*  _______________
+* |   | B |   |   |
+* |___|___|___|___|
+* | L | T | R | B |
+* |___|___|___|___|
+* |   | F |   |   |
+* |___|___|___|___|
+*/
+const vec2	tileSize = vec2(1.0 / 4.0, 1.0 / 3.0);
+const float	padding = 0.004;	// keeps the samples away from the neighbouring tiles
+
+// tile of every face, indexed like VertexFaces / 4
+const vec2	atlasTiles[6] = vec2[6](
+	vec2(1.0, 2.0),	// front
+	vec2(1.0, 0.0),	// back
+	vec2(0.0, 1.0),	// left
+	vec2(2.0, 1.0),	// right
+	vec2(1.0, 1.0),	// top
+	vec2(3.0, 1.0)	// bottom
+);
 
 void main()
 {
-	outColor = texture(texSampler, fragTexCoord);
+	// texture coordinates are in tile units, fract() repeats the tile over merged faces
+	vec2 local = fract(fragTexCoord);
+	vec2 origin = atlasTiles[min(fragFace, 5u)] * tileSize;
+	vec2 atlasUv = origin + mix(vec2(padding), tileSize - vec2(padding), local);
+
+	outColor = texture(texSampler, atlasUv);
 }
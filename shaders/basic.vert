@@ -7,15 +7,35 @@ layout(set = 0, binding = 0) uniform MatrixUBO
 	mat4	projection;
 }	ubo;
 
-layout(location = 0) in vec3 position;
-layout(location = 1) in vec3 normal;
-layout(location = 2) in vec2 uv;
+// 8 byte terrain vertex, see the packing description in include/World.hpp
+layout(location = 0) in uvec2 packedVertex;
 
 layout(location = 0) out vec2 fragTexCoord;
+layout(location = 1) flat out uint fragFace;
 
+const int	CHUNK_LENGTH = 16;	// Config::chunkLength
 
 void main()
 {
+	uint word = packedVertex.x;
+	vec3 local = vec3(bitfieldExtract(word, 0, 5), bitfieldExtract(word, 5, 9), bitfieldExtract(word, 14, 5));
+	uint face = bitfieldExtract(word, 19, 3);
+	ivec2 chunk = ivec2(bitfieldExtract(int(packedVertex.y), 0, 16), bitfieldExtract(int(packedVertex.y), 16, 16));
+	vec3 position = local + vec3(chunk.x * CHUNK_LENGTH, 0.0, chunk.y * CHUNK_LENGTH);
+
+	// project the position on the face, the fragment shader repeats the tile once per voxel
+	vec2 uv;
+	switch (face)
+	{
+		case 0u: uv = vec2(local.x, -local.y); break;	// front
+		case 1u: uv = vec2(local.x, local.y); break;	// back
+		case 2u: uv = vec2(local.y, local.z); break;	// left
+		case 3u: uv = vec2(-local.y, local.z); break;	// right
+		case 4u: uv = vec2(local.x, local.z); break;	// top
+		default: uv = vec2(local.z, local.x); break;	// bottom
+	}
+
 	gl_Position = ubo.projection * ubo.view * ubo.model * vec4(position, 1.0);
 	fragTexCoord = uv;
+	fragFace = face;
 }
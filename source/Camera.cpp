@@ -56,6 +56,10 @@ vec3 const& Camera::getCameraPos( void ) noexcept {
 	return this->_position;
 }
 
+vec3 const& Camera::getCameraForward( void ) const noexcept {
+	return this->_forward;
+}
+
 void Camera::moveForward( float delta ) noexcept {
 	vec3 progression = this->_position + this->_cameraForward * delta;
 	if (progression.x < this->_limits.x)
@@ -0,0 +1,44 @@
+#include "FrameBudget.hpp"
+
+#include <algorithm>
+
+FrameBudget::FrameBudget(double targetMs, double minimumMs, double maximumMs, size_t bytesPerFrame) noexcept :
+	targetMs(targetMs), minimumMs(minimumMs), maximumMs(maximumMs), allowanceMs(maximumMs),
+	bytesPerFrame(bytesPerFrame), bytesSpent(0), workDone(0), frameStart(Clock::now())
+{
+}
+
+void	FrameBudget::beginFrame() noexcept
+{
+	frameStart = Clock::now();
+	bytesSpent = 0;
+	workDone = 0;
+}
+
+/*	Halve the allowance when the frame ran over the target, grow it back by a tenth of the ceiling when
+	it fit: a burst of work backs off at once and the allowance recovers over a few frames. */
+
+void	FrameBudget::endFrame(double frameMs) noexcept
+{
+	if (frameMs > targetMs)
+	{
+		allowanceMs = std::max(minimumMs, allowanceMs * 0.5);
+	}
+	else
+	{
+		allowanceMs = std::min(maximumMs, allowanceMs + maximumMs * 0.1);
+	}
+}
+
+bool	FrameBudget::exhausted() const noexcept
+{
+	const double elapsedMs = std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count();
+
+	return workDone != 0 && (elapsedMs >= allowanceMs || bytesSpent >= bytesPerFrame);
+}
+
+void	FrameBudget::spend(size_t bytes) noexcept
+{
+	bytesSpent += bytes;
+	workDone++;
+}
@@ -1,21 +1,204 @@
 #include "ThreadManager.hpp"
+#include <algorithm>
 #include <iostream>
 
-ThreadManager::ThreadManager() : shouldRun(true), activeWorkers(0)
+/*	Pool of the current thread and its index in it, so tasks enqueued by a task go to its own deque. */
+
+static thread_local const ThreadManager*	currentPool = nullptr;
+static thread_local size_t					currentWorker = 0;
+
+/*	Starvation protection: every normalTurn-th task a thread takes, it looks at the normal lane before
+	the urgent one, and every backgroundTurn-th task at the background lane first. */
+
+static constexpr size_t	normalTurn = 4;
+static constexpr size_t	backgroundTurn = 16;
+static thread_local size_t	tasksTaken = 0;
+
+/*	Free task slots move between the threads in batches: each thread keeps its own free list, takes a
+	batch from the shared pool when it runs out, and gives one back when it holds two. Threads that
+	only submit and threads that only run tasks balance out without a lock per task. */
+
+static constexpr size_t	slotBatch = 64;
+static constexpr size_t	slotsPerSlab = slotBatch * 16;
+
+struct SlotPool
+{
+	std::mutex								mutex;
+	std::vector<TaskSlot*>					batches;	// free lists of slotBatch slots
+	std::vector<std::unique_ptr<TaskSlot[]>>	slabs;
+
+	static SlotPool&	instance()
+	{
+		static SlotPool pool;
+
+		return pool;
+	}
+};
+
+struct SlotCache
+{
+	TaskSlot*	head = nullptr;
+	size_t		count = 0;
+
+	~SlotCache()
+	{
+		SlotPool&					pool = SlotPool::instance();
+		std::lock_guard<std::mutex>	lock(pool.mutex);
+
+		while (head != nullptr)
+		{
+			TaskSlot* batch = head;
+			TaskSlot* last = head;
+
+			for (size_t i = 1; i < slotBatch && last->next != nullptr; i++)
+			{
+				last = last->next;
+			}
+			head = last->next;
+			last->next = nullptr;
+			pool.batches.push_back(batch);
+		}
+	}
+};
+
+static thread_local SlotCache	slotCache;
+
+TaskSlot*	TaskSlot::acquire()
+{
+	if (slotCache.head == nullptr)
+	{
+		SlotPool&					pool = SlotPool::instance();
+		std::lock_guard<std::mutex>	lock(pool.mutex);
+
+		if (pool.batches.empty() == true)
+		{
+			TaskSlot* slab = new TaskSlot[slotsPerSlab];
+
+			pool.slabs.emplace_back(slab);
+			for (size_t batch = 0; batch < slotsPerSlab; batch += slotBatch)
+			{
+				for (size_t i = batch; i < batch + slotBatch; i++)
+				{
+					slab[i].next = i + 1 < batch + slotBatch ? &slab[i + 1] : nullptr;
+				}
+				pool.batches.push_back(&slab[batch]);
+			}
+		}
+		slotCache.head = pool.batches.back();
+		slotCache.count = slotBatch;
+		pool.batches.pop_back();
+	}
+
+	TaskSlot* slot = slotCache.head;
+
+	slotCache.head = slot->next;
+	slotCache.count--;
+	return slot;
+}
+
+void	TaskSlot::release(TaskSlot* slot) noexcept
 {
-	int workers = std::thread::hardware_concurrency();
+	slot->next = slotCache.head;
+	slotCache.head = slot;
+	slotCache.count++;
+	if (slotCache.count < slotBatch * 2)
+	{
+		return;
+	}
+
+	TaskSlot* batch = slotCache.head;
+	TaskSlot* last = batch;
 
-	if (workers <= 0)
+	for (size_t i = 1; i < slotBatch; i++)
 	{
-		std::cerr << "Error: hardware returned " << workers << " threads as available" << std::endl;
+		last = last->next;
+	}
+	slotCache.head = last->next;
+	slotCache.count -= slotBatch;
+	last->next = nullptr;
+
+	SlotPool&					pool = SlotPool::instance();
+	std::lock_guard<std::mutex>	lock(pool.mutex);
+
+	pool.batches.push_back(batch);
+}
+
+/*	Destroys the callable of a task that will never run and gives its slot back. */
+
+void	TaskSlot::discard(TaskSlot* slot) noexcept
+{
+	slot->run(*slot, false);
+	release(slot);
+}
+
+void	ThreadManager::Lane::pushBack(TaskSlot* slot)
+{
+	if (count == ring.size())
+	{
+		std::vector<TaskSlot*> grown(std::max<size_t>(ring.size() * 2, 256));
+
+		for (size_t i = 0; i < count; i++)
+		{
+			grown[i] = ring[(head + i) % ring.size()];
+		}
+		ring.swap(grown);
+		head = 0;
+	}
+	ring[(head + count) % ring.size()] = slot;
+	count++;
+}
+
+TaskSlot*	ThreadManager::Lane::popBack() noexcept
+{
+	if (count == 0)
+	{
+		return nullptr;
+	}
+	count--;
+	return ring[(head + count) % ring.size()];
+}
+
+TaskSlot*	ThreadManager::Lane::popFront() noexcept
+{
+	if (count == 0)
+	{
+		return nullptr;
+	}
+
+	TaskSlot* slot = ring[head];
+
+	head = (head + 1) % ring.size();
+	count--;
+	return slot;
+}
+
+ThreadManager::ThreadManager() : ThreadManager(std::thread::hardware_concurrency())
+{
+}
+
+ThreadManager::ThreadManager(unsigned workerCount) :
+	nextWorker(0), queuedTasks(0), laneTasks{}, pendingTasks(0), sleepingWorkers(0), shouldRun(true)
+{
+	if (workerCount == 0)
+	{
+		std::cerr << "Error: hardware returned " << workerCount << " threads as available" << std::endl;
 		std::exit(EXIT_FAILURE);
 	}
 
-	std::cout << "Created " << workers << " worker threads" << std::endl;
-	workerThreads.reserve(workers);
-	for (int i = 0; i < workers; i++)
+	std::cout << "Created " << workerCount << " worker threads" << std::endl;
+	workers.reserve(workerCount);
+	for (unsigned i = 0; i < workerCount; i++)
 	{
-		workerThreads.emplace_back(&ThreadManager::workerLoop, this);
+		workers.push_back(std::make_unique<Worker>());
+		for (Lane& lane : workers.back()->lanes)
+		{
+			lane.ring.resize(256);
+		}
+	}
+	workerThreads.reserve(workerCount);
+	for (unsigned i = 0; i < workerCount; i++)
+	{
+		workerThreads.emplace_back(&ThreadManager::workerLoop, this, i);
 	}
 }
 
@@ -36,41 +219,175 @@ void ThreadManager::joinWorkerThreads()
 	workerThreads.clear();
 }
 
-/*	All worker threads are in this loop, waiting to be notified in cv.wait.
-	If a thread gets activated, it takes the first job in the queue and executes it. 
-	After finishing, it checks if there are still jobs to do, and if not, it notifies the main thread that is waiting for idle state in idleCv.wait.
-*/
+/*	Checked before a task is built or counted in its group, so a refused task leaves nothing behind. */
 
-void	ThreadManager::workerLoop()
+void	ThreadManager::ensureRunning() const
 {
-	while (true)
+	if (shouldRun.load() == false)
+	{
+		throw std::runtime_error("enqueue on stopped ThreadPool");
+	}
+}
+
+/*	A worker pushes to the back of its own deque, any other thread to the next deque in turn. A sleeping
+	worker is only woken when there is one: the task is counted before sleepingWorkers is read, and a
+	worker counts itself asleep before checking for tasks, so one of the two always sees the other.
+	The task is counted under the lock of the deque, before anyone can pop it. If the deque can't grow,
+	the task is destroyed without running and its group finished, as if it never was submitted. */
+
+void	ThreadManager::push(TaskSlot* task, TaskPriority priority)
+{
+	const size_t	target = currentPool == this ? currentWorker : nextWorker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+
+	const size_t	lane = static_cast<size_t>(priority);
+
+	try
+	{
+		std::lock_guard<std::mutex> lock(workers[target]->mutex);
+
+		workers[target]->lanes[lane].pushBack(task);
+		pendingTasks.fetch_add(1);
+		laneTasks[lane].fetch_add(1);
+	}
+	catch (...)
 	{
-		std::function<void()> job;
+		TaskGroup* group = task->group;
+
+		TaskSlot::discard(task);
+		if (group != nullptr)
 		{
-			std::unique_lock<std::mutex> lock(mutex);
+			group->finish();
+		}
+		throw;
+	}
+	queuedTasks.fetch_add(1);
+	if (sleepingWorkers.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+
+		cv.notify_one();
+	}
+}
 
-			cv.wait(lock, [this] { return shouldRun == false || jobs.empty() == false; });
+/*	The most urgent task the thread can find, lane by lane: the newest of its own deque, which is likely
+	still in cache, otherwise a stolen one. A thread outside the pool passes workerCount() as self and
+	only steals. Empty lanes are skipped without taking any lock. */
 
-			if (shouldRun == false && jobs.empty())
+TaskSlot*	ThreadManager::pop(size_t self)
+{
+	const size_t	turn = tasksTaken + 1;
+	const size_t	first = turn % backgroundTurn == 0 ? 2 : (turn % normalTurn == 0 ? 1 : 0);
+
+	for (size_t n = 0; n < laneCount; n++)
+	{
+		// first, then the others from the most urgent
+		const size_t	lane = n == 0 ? first : (n - 1 < first ? n - 1 : n);
+		TaskSlot*		task = nullptr;
+
+		if (laneTasks[lane].load() == 0)
+		{
+			continue;
+		}
+		if (self < workers.size())
+		{
+			Worker& own = *workers[self];
+			std::lock_guard<std::mutex> lock(own.mutex);
+
+			task = own.lanes[lane].popBack();
+			if (task != nullptr)
 			{
-				return;
+				laneTasks[lane].fetch_sub(1);
 			}
+		}
+		if (task == nullptr)
+		{
+			task = steal(self, lane);
+		}
+		if (task != nullptr)
+		{
+			tasksTaken = turn;
+			return task;
+		}
+	}
+	return nullptr;
+}
+
+/*	The oldest task of lane in the first deque after the one of thief that has one. A thread outside
+	the pool steals with a thief index of workerCount(), and looks at every deque. */
+
+TaskSlot*	ThreadManager::steal(size_t thief, size_t lane)
+{
+	for (size_t i = 1; i <= workers.size(); i++)
+	{
+		const size_t	index = (thief + i) % (workers.size() + 1);
 
-			job = std::move(jobs.front());
-			jobs.pop();
-			activeWorkers++;
+		if (index == workers.size())
+		{
+			continue;
 		}
 
-		job();
+		Worker& victim = *workers[index];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		TaskSlot* task = victim.lanes[lane].popFront();
 
+		if (task != nullptr)
 		{
-			std::lock_guard<std::mutex> lock(mutex);
+			laneTasks[lane].fetch_sub(1);
+			return task;
+		}
+	}
+	return nullptr;
+}
 
-			activeWorkers--;
-			if (jobs.empty() == true && activeWorkers == 0)
-			{
-				idleCv.notify_all();
-			}
+/*	Runs a task taken from a deque and gives its slot back. The thread finishing the last pending task
+	notifies the threads waiting for idle state in idleCv.wait. */
+
+void	ThreadManager::run(TaskSlot* task) noexcept
+{
+	TaskGroup* group = task->group;
+
+	queuedTasks.fetch_sub(1);
+	task->run(*task, true);
+	TaskSlot::release(task);
+	if (group != nullptr)
+	{
+		group->finish();
+	}
+	if (pendingTasks.fetch_sub(1) == 1)
+	{
+		std::lock_guard<std::mutex> lock(idleMutex);
+
+		idleCv.notify_all();
+	}
+}
+
+/*	All worker threads are in this loop. A worker runs tasks as long as it finds some in its own deque
+	or can steal one, then sleeps in cv.wait until a task is enqueued.
+	Once stopped, the workers finish the queued tasks before leaving.
+*/
+
+void	ThreadManager::workerLoop(size_t self)
+{
+	currentPool = this;
+	currentWorker = self;
+	while (true)
+	{
+		TaskSlot* task = pop(self);
+
+		if (task != nullptr)
+		{
+			run(task);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+
+		sleepingWorkers.fetch_add(1);
+		cv.wait(lock, [this] { return shouldRun.load() == false || queuedTasks.load() > 0; });
+		sleepingWorkers.fetch_sub(1);
+		if (shouldRun.load() == false && queuedTasks.load() == 0)
+		{
+			return;
 		}
 	}
 }
@@ -78,17 +395,125 @@ void	ThreadManager::workerLoop()
 void ThreadManager::stop()
 {
 	{
-		std::lock_guard<std::mutex> lock(mutex);
+		std::lock_guard<std::mutex> lock(sleepMutex);
 		shouldRun = false;
 	}
 	cv.notify_all();
 	joinWorkerThreads();
 }
 
+/*	The waiting thread runs queued tasks meanwhile, and only sleeps once every task left is running. */
+
 void	ThreadManager::waitIdle()
 {
-	std::unique_lock<std::mutex>	lock(mutex);
+	while (pendingTasks.load() != 0)
+	{
+		TaskSlot* task = pop(currentPool == this ? currentWorker : workers.size());
+
+		if (task != nullptr)
+		{
+			run(task);
+			continue;
+		}
+
+		std::unique_lock<std::mutex>	lock(idleMutex);
+
+		idleCv.wait(lock, [this] { return pendingTasks.load() == 0 || queuedTasks.load() > 0; });
+	}
+}
+
+/*	Waits for the tasks of group only, running queued tasks of any group meanwhile. With nothing left
+	to run, the thread sleeps until the last task of the group finishes. */
+
+void	ThreadManager::wait(TaskGroup& group)
+{
+	while (group.isDone() == false)
+	{
+		TaskSlot* task = pop(currentPool == this ? currentWorker : workers.size());
+
+		if (task != nullptr)
+		{
+			run(task);
+			continue;
+		}
+
+		std::unique_lock<std::mutex>	lock(group.mutex);
 
-	idleCv.wait(lock, [this] { return jobs.empty() == true && activeWorkers == 0; });
+		group.cv.wait(lock, [&group] { return group.pending.load() == 0; });
+	}
+
+	// the last task may still be notifying, the group can be destroyed once it released the lock
+	std::lock_guard<std::mutex>	lock(group.mutex);
+}
+
+std::shared_ptr<TaskHandle>	ThreadManager::submitRaisable(TaskGroup& group, TaskPriority priority, std::function<void()> function)
+{
+	ensureRunning();
+
+	std::shared_ptr<TaskHandle>	handle = std::make_shared<TaskHandle>(std::move(function), priority, &group);
+	TaskSlot*					slot = TaskSlot::make([handle] { handle->runOnce(); }, nullptr);
+
+	// the group is finished by the handle, not the slot, so push can't undo the count
+	group.pending.fetch_add(1);
+	try
+	{
+		push(slot, priority);
+	}
+	catch (...)
+	{
+		group.finish();
+		throw;
+	}
+	return handle;
 }
 
+/*	Queues handle again in the lane of priority if that is higher than its own and it didn't start yet.
+	The copy left in the lower lane does nothing when its turn comes. */
+
+void	ThreadManager::raise(const std::shared_ptr<TaskHandle>& handle, TaskPriority priority)
+{
+	ensureRunning();
+
+	TaskPriority	current = handle->priority.load();
+
+	do
+	{
+		if (priority >= current || handle->hasStarted() == true)
+		{
+			return;
+		}
+	}
+	while (handle->priority.compare_exchange_weak(current, priority) == false);
+	push(TaskSlot::make([handle] { handle->runOnce(); }, nullptr), priority);
+}
+
+/*	Only the first queued copy runs the function, and lets go of it so its captures don't outlive the
+	task. The group is finished here rather than by the pool, once for all the copies. */
+
+void	TaskHandle::runOnce() noexcept
+{
+	if (started.exchange(true) == true)
+	{
+		return;
+	}
+
+	std::function<void()>	task = std::move(function);
+
+	function = nullptr;
+	task();
+	task = nullptr;
+	if (group != nullptr)
+	{
+		group->finish();
+	}
+}
+
+void	TaskGroup::finish()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (pending.fetch_sub(1) == 1)
+	{
+		cv.notify_all();
+	}
+}
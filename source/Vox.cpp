@@ -12,14 +12,21 @@ namespace vox {
 
 /**
  * Create the engine of the game
+ *
+ * @param viewDistance number of chunks loaded around the player, in every direction
+ *
+ * @param memoryBudget bytes the voxels and meshes of the map may take, 0 for no limit
  */
-Vox::Vox( void ) :
+Vox::Vox( i32 viewDistance, ui64 memoryBudget ) :
 	vulkanWindow{Config::defaultWindowHeight, Config::defaultWindowWidth, "Vox"},
 	vulkanDevice{vulkanWindow},
 	vulkanRenderer{vulkanWindow, vulkanDevice},
 	vulkanSetFactory{vulkanDevice},
+	quadIndexBuffer{vulkanDevice},
+	vertexArena{vulkanDevice},
 	camera{vec3{165.0f, 225.0f, 165.0f}, CameraSettings::cameraForward, Config::cameraLimitsMov},
-	voxelMap{threadManager},
+	voxelMap{threadManager, viewDistance, memoryBudget},
+	uploadBudget{Config::frameTimeTarget, Config::uploadMinimumMs, Config::uploadMaximumMs, Config::uploadBytesPerFrame},
 	inputHandler{
 		[this](vec2 const& cursorPos) { this->rotateCameraFromCursorPos(cursorPos); },
 		[this](i32 width, i32 height) { this->resizeWindow(width, height); }
@@ -67,7 +74,6 @@ void Vox::setupVulkan( void )
 	this->samplersDescriptorSet->addSamplerToDescriptor(0, Config::texture2VoxelPath, ve::TextureType::TEXTURE_PLAIN);
 	this->samplersDescriptorSet->addSamplerToDescriptor(1, Config::textureSkyboxPath, ve::TextureType::TEXTURE_CUBEMAP);
 
-	this->terrainModel = this->voxelMap.createNewModel(vulkanDevice);
 	this->skyBoxModel = this->createSkyboxModel();
 
 	std::vector<VkDescriptorSetLayout> descriptorSetLayouts{this->matrixDescriptorSet->getDescriptorSetLayout(), this->samplersDescriptorSet->getDescriptorSetLayout()};
@@ -77,7 +83,7 @@ void Vox::setupVulkan( void )
 		this->vulkanRenderer.getSwapChainRenderPass(),
 		Config::terrainVertShaderPath,
 		Config::terrainFragShaderPath,
-		*this->terrainModel,
+		ve::ModelLayout::PACKED,
 		false
 	);
 
@@ -87,7 +93,7 @@ void Vox::setupVulkan( void )
 		this->vulkanRenderer.getSwapChainRenderPass(),
 		Config::skyboxVertShaderPath,
 		Config::skyboxFragShaderPath,
-		*this->skyBoxModel,
+		this->skyBoxModel->getLayout(),
 		true
 	);
 }
@@ -100,19 +106,19 @@ void Vox::run( void )
 	Stopwatch timer;
 
 	std::cout << "\n\n\n\n";
-	this->terrainModel = this->voxelMap.createNewModel(vulkanDevice);
 	while (vulkanWindow.shouldClose() == false)
 	{
 		glfwPollEvents();
 		timer.start();
 
 		this->moveCamera(timer.elapsed(Unit::Seconds));
+		this->changeViewDistance();
 
 		vec3 playerPos = this->camera.getCameraPos();
-		if (voxelMap.update(playerPos) == true)
-		{
-			this->terrainModel = voxelMap.createNewModel(vulkanDevice);
-		}
+		voxelMap.update(playerPos, this->camera.getCameraForward());
+		this->uploadBudget.beginFrame();
+		voxelMap.uploadMeshes(vertexArena, quadIndexBuffer, this->uploadBudget);
+		this->vertexArena.submitUploads();
 
 		VkCommandBuffer commandBuffer = this->vulkanRenderer.beginFrame();
 		if (commandBuffer != nullptr)
@@ -134,8 +140,7 @@ void Vox::run( void )
 			this->samplersDescriptorSet->bind(commandBuffer, *this->skyboxPipeline, 1U);
 
 			this->terrainPipeline->bind(commandBuffer);
-			terrainModel->bind(commandBuffer);
-			terrainModel->draw(commandBuffer);
+			voxelMap.draw(commandBuffer);
 
 			this->skyboxPipeline->bind(commandBuffer);
 			skyBoxModel->bind(commandBuffer);
@@ -146,6 +151,7 @@ void Vox::run( void )
 		}
 		this->inputHandler.reset();
 		timer.stop();
+		this->uploadBudget.endFrame(timer.elapsed(Unit::Milliseconds));
 
 		// std::cout << "\033[K" << "Player position - x: " << playerPos.x << " y: " << playerPos.y << " z: " << playerPos.z << std::endl;
 		// int	fps = static_cast<int> (1.0f / timer.elapsed(Unit::Seconds));
@@ -224,6 +230,22 @@ void Vox::moveCamera( float deltaTime )
 	}
 }
 
+/**
+ * Grow or shrink the view distance by a chunk with the + and - keys, the map resizes on its next update
+ */
+void Vox::changeViewDistance( void )
+{
+	if (this->inputHandler.isKeyReleased(GLFW_KEY_EQUAL) || this->inputHandler.isKeyReleased(GLFW_KEY_KP_ADD))
+	{
+		this->voxelMap.setViewDistance(this->voxelMap.getViewDistance() + 1);
+	}
+
+	if (this->inputHandler.isKeyReleased(GLFW_KEY_MINUS) || this->inputHandler.isKeyReleased(GLFW_KEY_KP_SUBTRACT))
+	{
+		this->voxelMap.setViewDistance(this->voxelMap.getViewDistance() - 1);
+	}
+}
+
 /**
  * Handle camera rotation my cursor movement
  *
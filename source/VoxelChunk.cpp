@@ -2,6 +2,8 @@
 #include "Config.hpp"
 #include "World.hpp"
 
+#include <algorithm>
+#include <bit>
 #include <cassert>
 #include <cstring>
 
@@ -23,6 +25,14 @@ VoxelChunk::VoxelChunk(vec2i loc) : location(loc)
 	worldPosition = vec3i(chunkDimensions.x * location.width, 0, chunkDimensions.z * location.depth);
 }
 
+void	VoxelChunk::setDimensions(const vec3i& dimensions) noexcept
+{
+	chunkDimensions = dimensions;
+	paddedDimensions = dimensions + vec3i{2, 2, 2};
+	chunkSize = static_cast<ui32>(dimensions.x * dimensions.y * dimensions.z);
+	paddedSize = static_cast<ui32>(paddedDimensions.x * paddedDimensions.y * paddedDimensions.z);
+}
+
 void	VoxelChunk::setLocation(vec2i loc)
 {
 	location = loc;
@@ -31,127 +41,624 @@ void	VoxelChunk::setLocation(vec2i loc)
 	worldPosition.z = chunkDimensions.z * loc.depth;
 }
 
+/*	Fills the chunk from the height noise. At a level of detail above 0 the chunk is made of cells of
+	2^lod voxels per side: the noise is sampled once per cell, at its centre, and the height is rounded
+	to a multiple of the cell size, so the chunk is built from whole cells that the greedy mesher turns
+	into a few large quads. The cells are stored voxel by voxel like any chunk, so the neighbours cull
+	their border faces against what this chunk actually draws and no gap opens between two levels. */
+
 void	VoxelChunk::generateMap(float seed)
 {
-	i32 y;
-	const i32 waterLevel = Config::seaLevel + 1;
-	const i32 dimX = paddedDimensions.x - 1;
-	const i32 dimY = paddedDimensions.y - 1;
-	const i32 dimZ = paddedDimensions.z - 1;
+	const i32 width = chunkDimensions.x;
+	const i32 depth = chunkDimensions.z;
 	const i32 height = chunkDimensions.y;
+	const i32 cell = 1 << lod;
+	std::array<i32, Config::chunkLength * Config::chunkLength> dirtHeights;
 
-	std::fill(map.begin(), map.end(), VoxelType::Padding);
+	assert(width == Config::chunkLength && depth == Config::chunkLength && "heightmap sized for Config::chunkLength");
+	assert(width % cell == 0 && depth % cell == 0 && "level of detail coarser than the chunk");
+	assert(Config::seaLevel <= height && "sea level higher than height of world");
 
-	for (i32 z = 1; z < dimZ; z++)
+	for (i32 z = 0; z < depth; z += cell)
 	{
-		for (i32 x = 1; x < dimX; x++)
+		for (i32 x = 0; x < width; x += cell)
 		{
-			i32 index = this->index(x, 1, z);
-
-			const float worldX = static_cast<float>(worldPosition.width + x - 1);
-			const float worldZ = static_cast<float>(worldPosition.depth + z - 1);
+			const float worldX = static_cast<float>(worldPosition.x + x + cell / 2);
+			const float worldZ = static_cast<float>(worldPosition.z + z + cell / 2);
 
 			float noiseValue = perlin(worldX * Config::noiseScalar, worldZ * Config::noiseScalar, static_cast<float>(seed));
-			i32 heightValue = static_cast<i32>(noiseValue * static_cast<float>(height)) + 1;
-
-			assert(heightValue <= chunkDimensions.height && "height value out of range");
-			assert(Config::seaLevel <= chunkDimensions.height && "sea level higher than height of world");
+			i32 dirt = static_cast<i32>(noiseValue * static_cast<float>(height));
 
-			for (y = 1; y < heightValue; y++)
-			{
-				map[index] = VoxelType::Dirt;
-				index++;
-			}
-			for (; y < waterLevel; y++)
+			dirt = (dirt + cell / 2) / cell * cell;
+			assert(dirt <= height && "height value out of range");
+			for (i32 dz = 0; dz < cell; dz++)
 			{
-				map[index] = VoxelType::Water;
-				index++;
+				std::fill_n(&dirtHeights[(z + dz) * width + x], cell, dirt);
 			}
-			for (; y < dimY; y++)
+		}
+	}
+
+	minHeight = height;
+	maxHeight = 0;
+	for (i32 z = 0; z < paddedDimensions.z; z++)
+	{
+		for (i32 x = 0; x < paddedDimensions.x; x++)
+		{
+			VoxelType* column = &map[index(x, 0, z)];
+
+			// the padding columns hide the border faces until copyAdjacentData fills them
+			if (x == 0 || z == 0 || x > width || z > depth)
 			{
-				map[index] = VoxelType::Air;
-				index++;
+				std::fill_n(column, paddedDimensions.y, VoxelType::Padding);
+				continue;
 			}
+
+			const i32 dirt = dirtHeights[(z - 1) * width + x - 1];
+			const i32 top = std::max(dirt, Config::seaLevel);
+
+			// a column is 3 runs, the air above the terrain being most of the chunk
+			column[0] = VoxelType::Padding;
+			std::fill_n(column + 1, dirt, VoxelType::Dirt);
+			std::fill_n(column + 1 + dirt, top - dirt, VoxelType::Water);
+			std::fill_n(column + 1 + top, height - top, VoxelType::Air);
+			column[height + 1] = VoxelType::Padding;
+			heightmap[(z - 1) * width + x - 1] = static_cast<ui16>(top);
+			minHeight = std::min(minHeight, top);
+			maxHeight = std::max(maxHeight, top);
 		}
 	}
+	setSections();
 }
 
-void	VoxelChunk::copyAdjacentData()
+/*	Columns are solid from the bottom up to their height, so the lowest and highest column are enough
+	to tell which sections are uniform. */
+
+void	VoxelChunk::setSections() noexcept
 {
-	const VoxelChunk* north = adjacentChunks[static_cast<size_t>(Direction::North)];
-	const VoxelChunk* east = adjacentChunks[static_cast<size_t>(Direction::East)];
-	const VoxelChunk* south = adjacentChunks[static_cast<size_t>(Direction::South)];
-	const VoxelChunk* west = adjacentChunks[static_cast<size_t>(Direction::West)];
+	for (i32 section = 0; section < sectionCount; section++)
+	{
+		const i32 bottom = section * sectionHeight;
 
+		if (maxHeight <= bottom)
+		{
+			sections[section] = SectionState::Air;
+		}
+		else if (minHeight >= bottom + sectionHeight)
+		{
+			sections[section] = SectionState::Solid;
+		}
+		else
+		{
+			sections[section] = SectionState::Mixed;
+		}
+	}
+}
+
+/**
+ * Copy the outer layer of the 4 neighbours into the padding of this chunk, the meshers read it to
+ * cull the faces on the chunk borders. Only the padding of this chunk is written and only the
+ * inside of the neighbours is read, so all chunks can copy at the same time as long as no chunk
+ * is being generated. Call it before generateVertexes whenever a neighbour changed
+ *
+ * @param neighbours the chunks around this one, the padding facing a nullptr is left as it is
+ */
+
+void	VoxelChunk::copyAdjacentData(const Neighbours& neighbours)
+{
+	for (size_t side = 0; side < neighbours.size(); side++)
+	{
+		if (neighbours[side] != nullptr)
+		{
+			copyBorder(static_cast<Direction>(side), *neighbours[side]);
+		}
+	}
+}
+
+void	VoxelChunk::copyBorder(Direction side, const VoxelChunk& neighbour)
+{
 	const i32 width = paddedDimensions.x - 1;
 	const i32 depth = paddedDimensions.z - 1;
 	const i32 copySize = chunkDimensions.y * sizeof(VoxelType);
 
-	if (north != nullptr)
+	switch (side)
 	{
-		for (i32 x = 1; x < width; x++)
-		{
-			i32 src = north->index(x, 1, 1);
-			i32 dst = this->index(x, 1, depth);
+		case Direction::North:
+			for (i32 x = 1; x < width; x++)
+			{
+				std::memcpy(&map[index(x, 1, depth)], neighbour.dataAt(neighbour.index(x, 1, 1)), copySize);
+			}
+			break;
+		case Direction::South:
+			for (i32 x = 1; x < width; x++)
+			{
+				std::memcpy(&map[index(x, 1, 0)], neighbour.dataAt(neighbour.index(x, 1, depth - 1)), copySize);
+			}
+			break;
+		case Direction::East:
+			for (i32 z = 1; z < depth; z++)
+			{
+				std::memcpy(&map[index(width, 1, z)], neighbour.dataAt(neighbour.index(1, 1, z)), copySize);
+			}
+			break;
+		case Direction::West:
+			for (i32 z = 1; z < depth; z++)
+			{
+				std::memcpy(&map[index(0, 1, z)], neighbour.dataAt(neighbour.index(width - 1, 1, z)), copySize);
+			}
+			break;
+	}
+}
+
+/*	Greedy meshing sweeps the chunk once per face direction. Each slice perpendicular to the face normal
+	gets a mask of the visible faces (the voxel type, or Air for no face), then maximal rectangles of
+	equal type are cut out of the mask row by row and emitted as single quads. */
+
+struct GreedySweep
+{
+	VertexFaces	face;
+	i32			normalAxis;		// 0 = x, 1 = y, 2 = z
+	i32			direction;		// +1 or -1 along normalAxis
+	i32			uAxis;			// the two axes spanning the face
+	i32			vAxis;
+};
+
+static constexpr std::array<GreedySweep, 6> greedySweeps{{
+	{VertexFaces::FRONT, 2, 1, 0, 1},
+	{VertexFaces::BACK, 2, -1, 0, 1},
+	{VertexFaces::LEFT, 0, -1, 2, 1},
+	{VertexFaces::RIGHT, 0, 1, 2, 1},
+	{VertexFaces::TOP, 1, 1, 0, 2},
+	{VertexFaces::BOTTOM, 1, -1, 0, 2}
+}};
+
+/*	Chunks with a lower level of detail are always merged, that is where their vertex savings come from. */
+
+MeshingMode	VoxelChunk::defaultMeshingMode() const noexcept
+{
+	if (Config::greedyMeshing == true || lod > 0)
+	{
+		return MeshingMode::Greedy;
+	}
+	return MeshingMode::Bitmask;
+}
+
+void	VoxelChunk::generateVertexes()
+{
+	generateVertexes(defaultMeshingMode());
+}
 
-			std::memcpy(static_cast<void*>(&map[dst]), north->dataAt(src), copySize);
+void	VoxelChunk::generateVertexes(MeshingMode mode)
+{
+	vertexes.clear();
+	meshOutdated = true;
+	if (mode == MeshingMode::Scalar)
+	{
+		generateScalarVertexes();
+		return;
+	}
+
+	std::vector<ColumnMask> faceMasks;
+
+	buildFaceMasks(faceMasks);
+	if (mode == MeshingMode::Greedy)
+	{
+		generateGreedyVertexes(faceMasks);
+	}
+	else
+	{
+		generateBitmaskVertexes(faceMasks);
+	}
+}
+
+/**
+ * Replace the GPU copy of the mesh with the current vertexes, a chunk without visible faces
+ * keeps no mesh at all
+ *
+ * @return the previous mesh, which frames in flight may still be drawing, so the caller decides
+ * when it is safe to release it
+ */
+
+std::unique_ptr<ve::VulkanModel>	VoxelChunk::uploadMesh(ve::VulkanVertexArena& arena, ve::VulkanQuadIndexBuffer& quadIndexes)
+{
+	std::unique_ptr<ve::VulkanModel>	previous = std::move(mesh);
+
+	if (vertexes.empty() == false)
+	{
+		mesh = std::make_unique<ve::VulkanModel>(arena, vertexes, quadIndexes);
+	}
+	meshOutdated = false;
+	return previous;
+}
+
+/*	Packs 8 consecutive voxels into 8 bits, a bit is set when its voxel is air. Air is the zero byte,
+	so the zero bytes of the word are found with the usual carry trick and their high bits gathered
+	into the lowest byte with a multiplication. */
+
+static_assert(static_cast<ui8>(VoxelType::Air) == 0, "airBits relies on air being the zero byte");
+
+static ui64	airBits(const VoxelType* voxels) noexcept
+{
+	constexpr ui64 low7 = 0x7F7F7F7F7F7F7F7FULL;
+	constexpr ui64 gather = 0x0102040810204080ULL;
+	ui64 word;
+
+	std::memcpy(&word, voxels, sizeof(word));
+
+	const ui64 zeroBytes = ~(((word & low7) + low7) | word | low7);
+
+	return ((zeroBytes >> 7) * gather) >> 56;
+}
+
+/*	Air mask of 64 consecutive voxels of a column. */
+
+static ui64	airWord(const VoxelType* voxels) noexcept
+{
+	ui64 bits = 0;
+
+	for (i32 byte = 0; byte < 64; byte += 8)
+	{
+		bits |= airBits(voxels + byte) << byte;
+	}
+	return bits;
+}
+
+/*	Bits of the mask word starting at height first that lie from bottom to top (excluded). */
+
+static ui64	spanBits(i32 first, i32 bottom, i32 top) noexcept
+{
+	const i32 low = std::clamp(bottom - first, 0, 64);
+	const i32 high = std::clamp(top - first, 0, 64);
+	const ui64 belowHigh = high == 64 ? ~ui64{0} : (ui64{1} << high) - 1;
+	const ui64 belowLow = low == 64 ? ~ui64{0} : (ui64{1} << low) - 1;
+
+	return belowHigh & ~belowLow;
+}
+
+/*	Builds one mask per face direction for every column of the chunk, stored as
+	faceMasks[faceSlot * columns + (z - 1) * width + (x - 1)] with faceSlot = VertexFaces / 4.
+	A set bit means the voxel is not air and its neighbour in that direction is air,
+	so the face is visible. The air masks of the padding columns hold the neighbour chunks.
+	Only the faces of the voxels from bottom to top (excluded) are set, and only the words
+	around them are read. */
+
+void	VoxelChunk::buildFaceMasks(std::vector<ColumnMask>& faceMasks, i32 bottom, i32 top) const
+{
+	const i32 paddedX = paddedDimensions.x;
+	const i32 paddedZ = paddedDimensions.z;
+	const i32 width = chunkDimensions.x;
+	const i32 depth = chunkDimensions.z;
+	const i32 columns = width * depth;
+	// no face can lie above the highest column, so the neighbours are only read up to there
+	const i32 usedWords = usedMaskWords();
+	const i32 firstWord = bottom / 64;
+	const i32 lastWord = std::min(usedWords, (top + 63) / 64);
+	// the faces above and below a word also depend on the last bit of the words around it
+	const i32 firstAirWord = std::max(firstWord - 1, 0);
+	const i32 lastAirWord = std::min(lastWord + 1, maskWords);
+
+	std::vector<ColumnMask> airMasks(static_cast<size_t>(paddedX * paddedZ));
+
+	// words made only of all-air or all-solid sections are the same for every column of this chunk,
+	// the padding columns still need to be read since they belong to the neighbours
+	constexpr i32 sectionsPerWord = 64 / sectionHeight;
+	std::array<bool, maskWords> uniformWord{};
+	ColumnMask uniformAir{};
+
+	for (i32 w = 0; w < maskWords; w++)
+	{
+		const SectionState* state = &sections[w * sectionsPerWord];
+
+		if (std::all_of(state, state + sectionsPerWord, [](SectionState s) { return s == SectionState::Air; }) == true)
+		{
+			uniformWord[w] = true;
+			uniformAir[w] = ~ui64{0};
+		}
+		else if (std::all_of(state, state + sectionsPerWord, [](SectionState s) { return s == SectionState::Solid; }) == true)
+		{
+			uniformWord[w] = true;
+			uniformAir[w] = 0;
 		}
 	}
-	if (south != nullptr)
+
+	for (i32 z = 0; z < paddedZ; z++)
 	{
-		for (i32 x = 1; x < width; x++)
+		for (i32 x = 0; x < paddedX; x++)
 		{
-			i32 src = south->index(x, 1, depth - 1);
-			i32 dst = this->index(x, 1, 0);
+			const VoxelType* column = dataAt(index(x, 1, z));
+			ColumnMask& air = airMasks[z * paddedX + x];
+			const bool padding = x == 0 || z == 0 || x == paddedX - 1 || z == paddedZ - 1;
+			const i32 words = padding == true ? std::min(usedWords, lastAirWord) : lastAirWord;
 
-			std::memcpy(&map[dst], south->dataAt(src), copySize);
+			for (i32 w = firstAirWord; w < words; w++)
+			{
+				if (padding == false && uniformWord[w] == true)
+				{
+					air[w] = uniformAir[w];
+					continue;
+				}
+
+				air[w] = airWord(column + w * 64);
+			}
 		}
 	}
-	if (east != nullptr)
+
+	faceMasks.assign(static_cast<size_t>(6 * columns), ColumnMask{});
+	for (i32 z = 1; z <= depth; z++)
 	{
-		for (i32 z = 1; z < depth; z++)
+		for (i32 x = 1; x <= width; x++)
 		{
-			i32 src = east->index(1, 1, z);
-			i32 dst = this->index(width, 1, z);
+			const ColumnMask& air = airMasks[z * paddedX + x];
+			const ColumnMask& north = airMasks[(z + 1) * paddedX + x];
+			const ColumnMask& south = airMasks[(z - 1) * paddedX + x];
+			const ColumnMask& west = airMasks[z * paddedX + x - 1];
+			const ColumnMask& east = airMasks[z * paddedX + x + 1];
+			const i32 column = (z - 1) * width + (x - 1);
 
-			std::memcpy(&map[dst], east->dataAt(src), copySize);
+			for (i32 w = firstWord; w < lastWord; w++)
+			{
+				// the padding layers below and above the column are never air
+				const ui64 solid = ~air[w] & spanBits(w * 64, bottom, top);
+				const ui64 above = (air[w] >> 1) | (w + 1 < maskWords ? air[w + 1] << 63 : 0);
+				const ui64 below = (air[w] << 1) | (w > 0 ? air[w - 1] >> 63 : 0);
+
+				faceMasks[0 * columns + column][w] = solid & north[w];
+				faceMasks[1 * columns + column][w] = solid & south[w];
+				faceMasks[2 * columns + column][w] = solid & west[w];
+				faceMasks[3 * columns + column][w] = solid & east[w];
+				faceMasks[4 * columns + column][w] = solid & above;
+				faceMasks[5 * columns + column][w] = solid & below;
+			}
 		}
 	}
-	if (west != nullptr)
+}
+
+/*	Face on each side of the chunk: the face slot (VertexFaces / 4) pointing to the neighbour, the axis
+	across the border and whether the border is at the far end of that axis. */
+
+struct BorderFace
+{
+	i32		slot;
+	i32		axis;
+	bool	far;
+};
+
+static constexpr std::array<BorderFace, 4>	borderFaces
+{{
+	{0, 2, true},	// North: FRONT faces of the last z slice
+	{3, 0, true},	// East: RIGHT faces of the last x slice
+	{1, 2, false},	// South: BACK faces of the first z slice
+	{2, 0, false}	// West: LEFT faces of the first x slice
+}};
+
+/*	Same layout as buildFaceMasks, with only the faces of the border voxels that point to the
+	neighbour on one side. */
+
+void	VoxelChunk::buildBorderFaceMasks(Direction side, std::vector<ColumnMask>& faceMasks) const
+{
+	const BorderFace& border = borderFaces[static_cast<size_t>(side)];
+	const i32 width = chunkDimensions.x;
+	const i32 columns = width * chunkDimensions.z;
+	const i32 usedWords = usedMaskWords();
+	const i32 length = chunkDimensions[border.axis == 0 ? 2 : 0];
+	const i32 inside = border.far == true ? chunkDimensions[border.axis] : 1;
+	const i32 outside = border.far == true ? inside + 1 : 0;
+
+	faceMasks.assign(static_cast<size_t>(6 * columns), ColumnMask{});
+	for (i32 i = 1; i <= length; i++)
 	{
-		for (i32 z = 1; z < depth; z++)
+		const i32 x = border.axis == 0 ? inside : i;
+		const i32 z = border.axis == 0 ? i : inside;
+		const VoxelType* column = dataAt(index(x, 1, z));
+		const VoxelType* neighbour = border.axis == 0 ? dataAt(index(outside, 1, z)) : dataAt(index(x, 1, outside));
+		ColumnMask& faces = faceMasks[border.slot * columns + (z - 1) * width + (x - 1)];
+
+		for (i32 w = 0; w < usedWords; w++)
 		{
-			i32 src = west->index(width - 1, 1, z);
-			i32 dst = this->index(0, 1, z);
+			faces[w] = ~airWord(column + w * 64) & airWord(neighbour + w * 64);
+		}
+	}
+}
 
-			std::memcpy(&map[dst], west->dataAt(src), copySize);
+/**
+ * Rebuild the faces between this chunk and its neighbour on one side, after that neighbour changed.
+ * Only the faces of the border voxels pointing to the neighbour depend on it, so those are dropped
+ * from the mesh and rebuilt from the new padding while the rest of the mesh is kept
+ *
+ * @param side the side of the neighbour that changed
+ * @param neighbour the chunk now on that side
+ */
+
+void	VoxelChunk::remeshBorder(Direction side, const VoxelChunk& neighbour)
+{
+	const BorderFace& border = borderFaces[static_cast<size_t>(side)];
+	const i32 plane = border.far == true ? chunkDimensions[border.axis] : 0;
+	size_t kept = 0;
+
+	copyBorder(side, neighbour);
+	// every corner of such a face lies on the border plane, checking the first one is enough
+	for (size_t quad = 0; quad < vertexes.size(); quad += 4)
+	{
+		const ui32 word = vertexes[quad].words[0];
+		const bool onBorder = unpackVertexFace(word) / 4 == static_cast<size_t>(border.slot)
+			&& unpackVertexPosition(word)[border.axis] == plane;
+
+		if (onBorder == true)
+		{
+			continue;
+		}
+		if (kept != quad)
+		{
+			std::copy_n(&vertexes[quad], 4, &vertexes[kept]);
 		}
+		kept += 4;
+	}
+	vertexes.resize(kept);
+
+	std::vector<ColumnMask> faceMasks;
+
+	buildBorderFaceMasks(side, faceMasks);
+	if (defaultMeshingMode() == MeshingMode::Greedy)
+	{
+		generateGreedyVertexes(faceMasks);
 	}
+	else
+	{
+		generateBitmaskVertexes(faceMasks);
+	}
+	meshOutdated = true;
 }
 
-void	VoxelChunk::setAdjacentChunks(VoxelChunk* north, VoxelChunk* east, VoxelChunk* south, VoxelChunk* west) noexcept
+/*	Heights of the voxels whose faces a quad covers, from bottom to top (excluded). The corners of a
+	TOP face lie on the top of its voxels, the other faces start at the bottom of theirs. */
+
+static vec2i	quadHeights(const TerrainVertex* quad) noexcept
 {
-	adjacentChunks[static_cast<size_t>(Direction::North)] = north;
-	adjacentChunks[static_cast<size_t>(Direction::East)] = east;
-	adjacentChunks[static_cast<size_t>(Direction::South)] = south;
-	adjacentChunks[static_cast<size_t>(Direction::West)] = west;
+	i32 low = unpackVertexPosition(quad[0].words[0]).y;
+	i32 high = low;
+
+	for (size_t corner = 1; corner < 4; corner++)
+	{
+		const i32 y = unpackVertexPosition(quad[corner].words[0]).y;
+
+		low = std::min(low, y);
+		high = std::max(high, y);
+	}
+	if (unpackVertexFace(quad[0].words[0]) == static_cast<size_t>(VertexFaces::TOP))
+	{
+		return vec2i{low - 1, low};
+	}
+	return vec2i{low, std::max(high, low + 1)};
 }
 
-void	VoxelChunk::generateVertexes()
+/**
+ * Rebuild the faces of the voxels of one section after they changed, the rest of the mesh is kept.
+ * A greedy quad may reach into the sections around, so the rebuilt heights grow until no kept quad
+ * overlaps them. The heightmap, the lowest and the highest column must be up to date
+ *
+ * @param section index of the section from the bottom, below sectionCount
+ */
+
+void	VoxelChunk::remeshSection(i32 section)
 {
-	vertexes.clear();
+	assert(section >= 0 && section < sectionCount && "section out of the chunk");
+
+	vec2i span{section * sectionHeight, (section + 1) * sectionHeight};
+	bool grown = true;
+
+	// an air section draws nothing, and a face of the section below it belongs to that section
+	if (sections[section] == SectionState::Air)
+	{
+		return;
+	}
+	while (grown == true)
+	{
+		grown = false;
+		for (size_t quad = 0; quad < vertexes.size(); quad += 4)
+		{
+			const vec2i heights = quadHeights(&vertexes[quad]);
+
+			if (heights.x < span.y && heights.y > span.x && (heights.x < span.x || heights.y > span.y))
+			{
+				span = vec2i{std::min(span.x, heights.x), std::max(span.y, heights.y)};
+				grown = true;
+			}
+		}
+	}
+
+	size_t kept = 0;
+
+	for (size_t quad = 0; quad < vertexes.size(); quad += 4)
+	{
+		const vec2i heights = quadHeights(&vertexes[quad]);
 
+		if (heights.x < span.y && heights.y > span.x)
+		{
+			continue;
+		}
+		if (kept != quad)
+		{
+			std::copy_n(&vertexes[quad], 4, &vertexes[kept]);
+		}
+		kept += 4;
+	}
+	vertexes.resize(kept);
+
+	std::vector<ColumnMask> faceMasks;
+
+	buildFaceMasks(faceMasks, span.x, span.y);
+	if (defaultMeshingMode() == MeshingMode::Greedy)
+	{
+		generateGreedyVertexes(faceMasks);
+	}
+	else
+	{
+		generateBitmaskVertexes(faceMasks);
+	}
+	meshOutdated = true;
+}
+
+/*	Walks the set bits of the face masks column by column, in the same order as generateScalarVertexes,
+	so both produce an identical vertex buffer. */
+
+void	VoxelChunk::generateBitmaskVertexes(const std::vector<ColumnMask>& faceMasks)
+{
+	const i32 width = chunkDimensions.x;
+	const i32 depth = chunkDimensions.z;
+	const i32 columns = width * depth;
+	const i32 usedWords = usedMaskWords();
+
+	const ui32 chunkWord = packChunkLocation(location);
+
+	for (i32 z = 0; z < depth; z++)
+	{
+		for (i32 x = 0; x < width; x++)
+		{
+			const i32 column = z * width + x;
+
+			for (i32 w = 0; w < usedWords; w++)
+			{
+				std::array<ui64, 6> faces;
+				ui64 anyFace = 0;
+
+				for (i32 face = 0; face < 6; face++)
+				{
+					faces[face] = faceMasks[face * columns + column][w];
+					anyFace |= faces[face];
+				}
+				while (anyFace != 0)
+				{
+					const i32 bit = std::countr_zero(anyFace);
+					const ui64 flag = ui64{1} << bit;
+
+					anyFace &= anyFace - 1;
+
+					const vec3i local{x, w * 64 + bit, z};
+					const VoxelType type = at(x + 1, local.y + 1, z + 1);
+
+					for (i32 face = 0; face < 6; face++)
+					{
+						if ((faces[face] & flag) != 0)
+						{
+							addVoxelFace(local, vertexes, static_cast<size_t>(face * 4), type, chunkWord);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+void	VoxelChunk::generateScalarVertexes()
+{
 	const i32 widthMax = paddedDimensions.x - 1;
-	const i32 dimY = paddedDimensions.y - 1;
+	const i32 dimY = maxHeight + 1;
 	const i32 depthMax = paddedDimensions.z - 1;
 
 	const i32 xStride = paddedDimensions.y;
 	const i32 zStride = paddedDimensions.x * paddedDimensions.y;
 
-	const float worldX = static_cast<float>(worldPosition.x);
-	const float worldZ = static_cast<float>(worldPosition.z);
+	const ui32 chunkWord = packChunkLocation(location);
 
-	copyAdjacentData();
 	for (i32 z = 1; z < depthMax; z++)
 	{
 		for (i32 x = 1; x < widthMax; x++)
@@ -164,35 +671,143 @@ void	VoxelChunk::generateVertexes()
 					continue;
 				}
 
-				vec3 world{worldX + static_cast<float>(x - 1), static_cast<float>(y - 1), worldZ + static_cast<float>(z - 1)};
+				const vec3i local{x - 1, y - 1, z - 1};
+				const VoxelType type = map[i];
 
 				if (map[i + zStride] == VoxelType::Air)
 				{
-					addVoxelFace(world, vertexes, static_cast<size_t>(VertexFaces::FRONT));
+					addVoxelFace(local, vertexes, static_cast<size_t>(VertexFaces::FRONT), type, chunkWord);
 				}
 				if (map[i - zStride] == VoxelType::Air)
 				{
-					addVoxelFace(world, vertexes, static_cast<size_t>(VertexFaces::BACK));
+					addVoxelFace(local, vertexes, static_cast<size_t>(VertexFaces::BACK), type, chunkWord);
 				}
 				if (map[i - xStride] == VoxelType::Air)
 				{
-					addVoxelFace(world, vertexes, static_cast<size_t>(VertexFaces::LEFT));
+					addVoxelFace(local, vertexes, static_cast<size_t>(VertexFaces::LEFT), type, chunkWord);
 				}
 				if (map[i + xStride] == VoxelType::Air)
 				{
-					addVoxelFace(world, vertexes, static_cast<size_t>(VertexFaces::RIGHT));
+					addVoxelFace(local, vertexes, static_cast<size_t>(VertexFaces::RIGHT), type, chunkWord);
 				}
 				if (map[i + 1] == VoxelType::Air)
 				{
-					addVoxelFace(world, vertexes, static_cast<size_t>(VertexFaces::TOP));
+					addVoxelFace(local, vertexes, static_cast<size_t>(VertexFaces::TOP), type, chunkWord);
 				}
 				if (map[i - 1] == VoxelType::Air)
 				{
-					addVoxelFace(world, vertexes, static_cast<size_t>(VertexFaces::BOTTOM));
+					addVoxelFace(local, vertexes, static_cast<size_t>(VertexFaces::BOTTOM), type, chunkWord);
+				}
+			}
+		}
+	}
+}
+
+void	VoxelChunk::generateGreedyVertexes(const std::vector<ColumnMask>& faceMasks)
+{
+	const i32 width = chunkDimensions.x;
+	const i32 columns = chunkDimensions.x * chunkDimensions.z;
+	const i32 usedWords = usedMaskWords();
+
+	const ui32 chunkWord = packChunkLocation(location);
+
+	std::vector<VoxelType> mask;
+	std::vector<vec2i> rowRanges;
+
+	for (const GreedySweep& sweep : greedySweeps)
+	{
+		const i32 n = sweep.normalAxis;
+		const i32 u = sweep.uAxis;
+		const i32 v = sweep.vAxis;
+		const i32 uSize = chunkDimensions[u];
+		const i32 vSize = chunkDimensions[v];
+		const i32 sliceSize = uSize * vSize;
+		const i32 sliceCount = n == 1 ? maxHeight : chunkDimensions[n];
+		const ColumnMask* masks = &faceMasks[static_cast<size_t>(sweep.face) / 4 * columns];
+
+		if (std::all_of(masks, masks + columns, [](const ColumnMask& m) { return m == ColumnMask{}; }) == true)
+		{
+			continue;
+		}
+
+		// scatter the visible faces into one mask per slice, remembering which rows of a slice are used
+		mask.assign(static_cast<size_t>(sliceCount * sliceSize), VoxelType::Air);
+		rowRanges.assign(static_cast<size_t>(sliceCount), vec2i{vSize, -1});
+		for (i32 column = 0; column < columns; column++)
+		{
+			for (i32 w = 0; w < usedWords; w++)
+			{
+				ui64 bits = masks[column][w];
+
+				while (bits != 0)
+				{
+					const vec3i pos{column % width + 1, w * 64 + std::countr_zero(bits) + 1, column / width + 1};
+					const i32 slice = pos[n] - 1;
+					const i32 row = pos[v] - 1;
+
+					bits &= bits - 1;
+					mask[slice * sliceSize + row * uSize + pos[u] - 1] = at(pos.x, pos.y, pos.z);
+					rowRanges[slice].x = std::min(rowRanges[slice].x, row);
+					rowRanges[slice].y = std::max(rowRanges[slice].y, row);
+				}
+			}
+		}
+
+		for (i32 slice = 0; slice < sliceCount; slice++)
+		{
+			VoxelType* sliceMask = &mask[slice * sliceSize];
+			vec3i pos;
+
+			pos[n] = slice + 1;
+			for (i32 b = rowRanges[slice].x; b <= rowRanges[slice].y; b++)
+			{
+				i32 a = 0;
+
+				while (a < uSize)
+				{
+					const VoxelType type = sliceMask[b * uSize + a];
+
+					if (type == VoxelType::Air)
+					{
+						a++;
+						continue;
+					}
+
+					i32 faceWidth = 1;
+					while (a + faceWidth < uSize && sliceMask[b * uSize + a + faceWidth] == type)
+					{
+						faceWidth++;
+					}
+
+					i32 faceHeight = 1;
+					while (b + faceHeight <= rowRanges[slice].y)
+					{
+						const VoxelType* row = &sliceMask[(b + faceHeight) * uSize + a];
+
+						if (std::any_of(row, row + faceWidth, [type](VoxelType t) { return t != type; }) == true)
+						{
+							break;
+						}
+						faceHeight++;
+					}
+					for (i32 h = 0; h < faceHeight; h++)
+					{
+						std::fill_n(&sliceMask[(b + h) * uSize + a], faceWidth, VoxelType::Air);
+					}
+
+					vec3i size{1};
+
+					size[u] = faceWidth;
+					size[v] = faceHeight;
+					pos[u] = a + 1;
+					pos[v] = b + 1;
+
+					addVoxelFace(pos - vec3i{1}, vertexes, static_cast<size_t>(sweep.face), type, chunkWord, size);
+					a += faceWidth;
 				}
 			}
 		}
 	}
 }
 
-}	// namespace vox
\ No newline at end of file
+}	// namespace vox
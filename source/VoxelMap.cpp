@@ -15,144 +15,329 @@ namespace vox {
 
 using i32 = int32_t;
 
-VoxelMap::VoxelMap(ThreadManager& threadManager) : threadManager(threadManager)
+VoxelMap::VoxelMap(ThreadManager& threadManager, i32 viewDistance, ui64 memoryBudget) :
+	memoryBudget(memoryBudget), threadManager(threadManager)
 {
-	i32 visibleVoxels = static_cast<i32>(Config::minimumViewingDistance * 2);
-	this->squareSize = visibleVoxels / static_cast<i32>(Config::chunkLength) + 1;
-	i32 visibleChunks = this->squareSize * this->squareSize;
-
-	std::cout << "Visible chunks: " << visibleChunks << std::endl;
-	VoxelChunk::chunkDimensions = vec3i{Config::chunkLength, Config::chunkHeight, Config::chunkLength};
+	VoxelChunk::setDimensions(vec3i{Config::chunkLength, Config::chunkHeight, Config::chunkLength});
 	std::cout << "Chunk dimensions: " << VoxelChunk::chunkDimensions << std::endl;
-	VoxelChunk::chunkSize = Config::chunkLength * Config::chunkHeight * Config::chunkLength;
-	VoxelChunk::paddedSize = (Config::chunkLength + 2) * (Config::chunkHeight + 2) * (Config::chunkLength + 2);
 
-	std::cout << "Allocating: " << formatBytes(VoxelChunk::chunkSize * visibleChunks * sizeof(VoxelType)) << " for voxel map" << std::endl;
+	averageMeshBytes = 0;
+	this->viewRadius = budgetDistance(viewDistance);
+	this->requestedRadius = this->viewRadius;
+	this->squareSize = this->viewRadius * 2 + 1;
+	i32 squareChunks = this->squareSize * this->squareSize;
+	i32 visibleChunks = visibleChunkCount(this->viewRadius);
+
+	std::cout << "View distance: " << viewRadius << " chunks" << std::endl;
+	std::cout << "Visible chunks: " << visibleChunks << " of " << squareChunks << " in the square, "
+		<< (squareChunks - visibleChunks) * 100 / squareChunks << "% less" << std::endl;
+	std::cout << "Allocating: " << formatBytes(VoxelChunk::chunkSize * visibleChunks * sizeof(VoxelType)) << " for voxel map, saving "
+		<< formatBytes(VoxelChunk::chunkSize * (squareChunks - visibleChunks) * sizeof(VoxelType)) << std::endl;
+	if (memoryBudget != 0)
+	{
+		std::cout << "Memory budget: " << formatBytes(memoryBudget) << std::endl;
+	}
 
-	map.reserve(visibleChunks);
+	map.reserve(squareChunks);
 	minPositions = vec2i{0, 0};
 	maxPositions = vec2i{minPositions.x + squareSize - 1, minPositions.y + squareSize - 1};
 	std::cout << "Map ranges from: " << minPositions << " to: " << maxPositions << std::endl;
 	worldSeed = 0;
-	playerOnChunk = vec2i{minPositions.x + squareSize / 2, minPositions.y + squareSize / 2};
+	playerOnChunk = vec2i{minPositions.x + viewRadius, minPositions.y + viewRadius};
 	rawPosition = vec3::zero();
-	VoxelChunk::paddedDimensions = VoxelChunk::chunkDimensions + vec3i{2, 2, 2};
+	travelDirection = vec3::zero();
+	velocity = vec3::zero();
+	epoch.store(0, std::memory_order_relaxed);
+	closing.store(false, std::memory_order_relaxed);
+	epochChunk = playerOnChunk;
+	mapComplete = true;
+	cacheHits = 0;
+	cacheMisses = 0;
+	lastUpdate = Clock::now();
+	uploadFrame = 0;
 }
 
-std::unique_ptr<ve::VulkanModel> VoxelMap::createNewModel( ve::VulkanDevice& device )
+/*	Step and prefetch jobs still running on the pool point to this map, the rest of the pool can keep going.
+	The jobs left are cancelled first, so they end at once and don't queue any more. */
+
+VoxelMap::~VoxelMap()
 {
-	std::unique_ptr<ve::VulkanModel> model;
-	size_t totalVertexes = 0;
+	closing.store(true, std::memory_order_relaxed);
+	epoch.fetch_add(1, std::memory_order_relaxed);
+	for (const auto& [key, entry] : prefetched)
+	{
+		entry->dropped.store(true, std::memory_order_relaxed);
+	}
+	threadManager.wait(poolTasks);
+}
+
+/**
+ * Swap in the new chunks of the step meshed since the last call, and upload the meshes of the chunks
+ * the pool handed back, every other chunk keeps the buffers it already has. A new chunk only replaces
+ * the chunk of its slot once its mesh is on the GPU, so the map never shows a hole. Called once per
+ * frame, before recording the draws. The copies are only recorded, arena.submitUploads() sends them
+ * all at once before the frame is submitted
+ *
+ * @param budget share of the frame for the swaps and uploads, what doesn't fit waits for the next frames
+ */
+
+void	VoxelMap::uploadMeshes(ve::VulkanVertexArena& arena, ve::VulkanQuadIndexBuffer& quadIndexes, FrameBudget& budget)
+{
+	std::vector<ChunkPtr>	carried;
+	size_t					done = 0;
 
-	modelVector.clear();
-	modelIndexes.clear();
-	for (size_t i = 0; i < map.size(); i++)
+	uploadFrame++;
+	while (retiredMeshes.empty() == false && retiredMeshes.front().frame + ve::VulkanSwapChain::MAX_FRAMES_IN_FLIGHT < uploadFrame)
 	{
-		totalVertexes += map[i].getVertexSize();
+		retiredMeshes.pop_front();
 	}
-	if (totalVertexes > modelVector.capacity())
+	if (stream != nullptr)
 	{
-		modelVector.reserve(totalVertexes);
-		modelIndexes.reserve(totalVertexes * 6 / 4);
+		{
+			std::lock_guard<std::mutex> lock(stream->queueMutex);
+
+			pendingInstalls.insert(pendingInstalls.end(), stream->finished.begin(), stream->finished.end());
+			stream->finished.clear();
+		}
+		for (; done < pendingInstalls.size() && budget.exhausted() == false; done++)
+		{
+			const i32		slot = pendingInstalls[done];
+			const ChunkPtr&	chunk = stream->incoming[slot];
+
+			budget.spend(uploadChunk(*chunk, arena, quadIndexes));
+			if (map[slot] != nullptr)
+			{
+				evict(std::move(map[slot]));
+			}
+			map[slot] = chunk;
+		}
+		pendingInstalls.erase(pendingInstalls.begin(), pendingInstalls.begin() + done);
 	}
-	for (size_t i = 0; i < map.size(); i++)
+	for (done = 0; done < pendingUploads.size(); done++)
 	{
-		const VertexVector& chunkVertexes = map[i].getVertexData();
+		const ChunkPtr& chunk = pendingUploads[done];
 
-		modelVector.insert(modelVector.end(), chunkVertexes.begin(), chunkVertexes.end());
+		// the running step rebuilds its borders, it comes back when the step ends: its mesh is left
+		// alone until then, a Border job may be writing it
+		if (stream != nullptr && stream->borderSides[slotOf(chunk->getLocation())] != 0)
+		{
+			continue;
+		}
+		// a chunk replaced before its upload is never drawn
+		if (map[slotOf(chunk->getLocation())] != chunk || chunk->needsUpload() == false)
+		{
+			continue;
+		}
+		if (budget.exhausted() == true)
+		{
+			break;
+		}
+		budget.spend(uploadChunk(*chunk, arena, quadIndexes));
 	}
-	for (ui32 i = 0; i < modelVector.size(); i += 4)
+	carried.assign(pendingUploads.begin() + done, pendingUploads.end());
+	pendingUploads.swap(carried);
+}
+
+/*	Upload the mesh of a chunk and retire the one it replaces. Returns the bytes of vertexes uploaded. */
+
+size_t	VoxelMap::uploadChunk(VoxelChunk& chunk, ve::VulkanVertexArena& arena, ve::VulkanQuadIndexBuffer& quadIndexes)
+{
+	std::unique_ptr<ve::VulkanModel> previous = chunk.uploadMesh(arena, quadIndexes);
+
+	if (previous != nullptr)
 	{
-		IndexVector indexes = {0U + i, 1U + i, 2U + i, 0U + i, 2U + i, 3U + i};
-		modelIndexes.insert(modelIndexes.end(), indexes.begin(), indexes.end());
+		retiredMeshes.push_back(RetiredMesh{uploadFrame, std::move(previous)});
 	}
-	model = std::make_unique<ve::VulkanModel>(device, modelVector, modelIndexes, 0U, ve::DEFAULT_MODEL_LAYOUT);
-	return model;
+	return chunk.getVertexSize() * sizeof(TerrainVertex);
 }
 
-void	VoxelMap::setAdjacentPointers()
+void	VoxelMap::draw(VkCommandBuffer commandBuffer) const
 {
-	i32 index = 0;
-	for (i32 depth = 0; depth < squareSize; depth++)
+	for (const ChunkPtr& chunk : map)
 	{
-		for (i32 width = 0; width < squareSize; width++)
-		{
-			VoxelChunk* north;
-			VoxelChunk* east;
-			VoxelChunk* south;
-			VoxelChunk* west;
+		ve::VulkanModel* mesh = chunk != nullptr ? chunk->getMesh() : nullptr;
 
-			if (depth == 0)
-			{
-				south = nullptr;
-			}
-			else
-			{
-				south = &map[index - squareSize];
-			}
-			if (depth == squareSize - 1)
-			{
-				north = nullptr;
-			}
-			else
-			{
-				north = &map[index + squareSize];
-			}
-			if (width == 0)
-			{
-				west = nullptr;
-			}
-			else
-			{
-				west = &map[index - 1];
-			}
-			if (width == squareSize - 1)
-			{
-				east = nullptr;
-			}
-			else
-			{
-				east = &map[index + 1];
-			}
-			map[index].setAdjacentChunks(north, east, south, west);
-			index++;
+		if (mesh != nullptr)
+		{
+			mesh->bind(commandBuffer);
+			mesh->draw(commandBuffer);
 		}
 	}
 }
 
+i32	VoxelMap::slotOf(const vec2i& location) const noexcept
+{
+	const i32 x = ((location.x % squareSize) + squareSize) % squareSize;
+	const i32 z = ((location.y % squareSize) + squareSize) % squareSize;
+
+	return z * squareSize + x;
+}
+
+/*	Chunk at location, nullptr outside the view. Given a step, the window is the one it moves to with
+	its new chunks in place. */
+
+const VoxelChunk*	VoxelMap::chunkAt(const vec2i& location, const StreamStep* step) const noexcept
+{
+	if (inView(location, step != nullptr ? step->playerOnChunk : playerOnChunk) == false)
+	{
+		return nullptr;
+	}
+
+	const i32 slot = slotOf(location);
+
+	if (step != nullptr && step->incoming[slot] != nullptr)
+	{
+		return step->incoming[slot].get();
+	}
+	return map[slot].get();
+}
+
+Neighbours	VoxelMap::neighboursOf(const vec2i& location, const StreamStep* step) const noexcept
+{
+	return {
+		chunkAt(vec2i{location.x, location.y + 1}, step),
+		chunkAt(vec2i{location.x + 1, location.y}, step),
+		chunkAt(vec2i{location.x, location.y - 1}, step),
+		chunkAt(vec2i{location.x - 1, location.y}, step)
+	};
+}
+
 void	VoxelMap::init()
 {
 	Stopwatch timer;
 	
 	timer.start();
 	
+	map.resize(squareSize * squareSize);
 	for (i32 z = 0; z < squareSize; z++)
 	{
 		for (i32 x = 0; x < squareSize; x++)
 		{
-			VoxelChunk chunk(vec2i(minPositions.x + x, minPositions.y + z));
-			map.emplace_back(std::move(chunk));
+			const vec2i location(minPositions.x + x, minPositions.y + z);
+
+			if (inView(location, playerOnChunk) == true)
+			{
+				map[slotOf(location)] = std::make_shared<VoxelChunk>(location);
+			}
 		}
 	}
-	setAdjacentPointers();
-	for (VoxelChunk& chunk : map)
-	{
-		threadManager.enqueue([&] {
-			chunk.generateMap(worldSeed);
-		});
-	}
-	threadManager.waitIdle();
+	threadManager.parallel_for(0, map.size(), 1, [this](size_t slot) {
+		const ChunkPtr& chunk = map[slot];
+
+		if (chunk != nullptr)
+		{
+			chunk->setLod(lodFor(chunk->getLocation(), playerOnChunk));
+			chunk->generateMap(worldSeed);
+		}
+	});
 	timer.stop();
 	std::cout << "Initial chunk generation complete in: " << timer << std::endl;
 	timer.reset();
 	timer.start();
-	for (size_t i = 0; i < map.size(); i++)
+	meshChunks();
+	for (const ChunkPtr& chunk : map)
 	{
-		map[i].generateVertexes();
+		if (chunk != nullptr)
+		{
+			pendingUploads.push_back(chunk);
+		}
 	}
-	threadManager.waitIdle();
 	timer.stop();
+
+	size_t totalVertexes = 0;
+	for (const ChunkPtr& chunk : map)
+	{
+		totalVertexes += chunk != nullptr ? chunk->getVertexSize() : 0;
+	}
 	std::cout << "Initial voxel map generation took: " << timer << std::endl;
+	std::cout << "Terrain mesh: " << totalVertexes << " vertexes, " << formatBytes(totalVertexes * sizeof(TerrainVertex)) << std::endl;
+	checkMemoryBudget();
+}
+
+/*	Voxels counted like the Allocating line of the constructor, plus the vertexes of the meshes, the
+	voxels of the prefetched chunks and the cached chunks. Only call it while no step is streaming,
+	the pool may be resizing the meshes of the map otherwise. */
+
+size_t	VoxelMap::memoryUsage() const noexcept
+{
+	size_t bytes = prefetched.size() * VoxelChunk::chunkSize * sizeof(VoxelType);
+
+	for (const ChunkPtr& chunk : map)
+	{
+		if (chunk != nullptr)
+		{
+			bytes += VoxelChunk::chunkSize * sizeof(VoxelType) + chunk->getVertexSize() * sizeof(TerrainVertex);
+		}
+	}
+	for (const ChunkPtr& chunk : cacheOrder)
+	{
+		bytes += VoxelChunk::chunkSize * sizeof(VoxelType) + chunk->getVertexSize() * sizeof(TerrainVertex);
+	}
+	return bytes;
+}
+
+/*	Largest view distance up to chunks that fits the memory budget, with the meshes of the chunks
+	taken at the average size measured so far. */
+
+i32	VoxelMap::budgetDistance(i32 chunks) const noexcept
+{
+	const size_t	chunkBytes = VoxelChunk::chunkSize * sizeof(VoxelType) + averageMeshBytes;
+	i32				distance = std::clamp(chunks, 1, Config::maximumViewDistance);
+
+	while (memoryBudget != 0 && distance > 1 && visibleChunkCount(distance) * chunkBytes > memoryBudget)
+	{
+		distance--;
+	}
+	return distance;
+}
+
+void	VoxelMap::setViewDistance(i32 chunks)
+{
+	const i32 distance = budgetDistance(chunks);
+
+	// raising a distance below 1 to the minimum is not worth a message
+	if (distance < chunks)
+	{
+		std::cout << "View distance " << chunks << " capped to " << distance << " chunks" << std::endl;
+	}
+	requestedRadius = distance;
+}
+
+/*	Once the real size of the meshes is known the estimate may turn out too low. The cache gives its
+	chunks back first, then the view shrinks one chunk at a time until it fits. */
+
+void	VoxelMap::checkMemoryBudget()
+{
+	size_t	meshBytes = 0;
+	i32		chunks = 0;
+
+	for (const ChunkPtr& chunk : map)
+	{
+		if (chunk != nullptr)
+		{
+			meshBytes += chunk->getVertexSize() * sizeof(TerrainVertex);
+			chunks++;
+		}
+	}
+	averageMeshBytes = chunks != 0 ? meshBytes / chunks : 0;
+	if (memoryBudget == 0)
+	{
+		return;
+	}
+
+	size_t	usage = memoryUsage();
+
+	while (usage > memoryBudget && cacheOrder.empty() == false)
+	{
+		usage -= VoxelChunk::chunkSize * sizeof(VoxelType) + cacheOrder.back()->getVertexSize() * sizeof(TerrainVertex);
+		cache[cacheOrder.back()->getLod()].erase(locationKey(cacheOrder.back()->getLocation()));
+		cacheOrder.pop_back();
+	}
+	if (usage > memoryBudget && viewRadius > 1 && requestedRadius == viewRadius)
+	{
+		std::cout << "Memory budget exceeded: " << formatBytes(usage) << " in use" << std::endl;
+		setViewDistance(viewRadius - 1);
+	}
 }
 
 vec2i	VoxelMap::voxelToChunkPosition(const vec3& position) const noexcept
@@ -1,157 +1,733 @@
 #include "VoxelMap.hpp"
+#include "Camera.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
 
 namespace vox {
 
-/*	From -x (left/west) to +x (right/east) horizontally, y (up/north) to -y (down/south) vertically. */
+/*	From -x (left/west) to +x (right/east) horizontally, y (up/north) to -y (down/south) vertically.
+	The window jumps to the chunk of the player in a single step, whatever the distance: the step is
+	generated and meshed on the thread pool while the current map keeps being drawn, uploadMeshes swaps
+	its chunks in as they finish and it ends with the first update after they are all in. Returns true
+	when the map changed. */
 
-bool	VoxelMap::update(const vec3& newPosition)
+bool	VoxelMap::update(const vec3& newPosition, const vec3& viewDirection)
 {
-	vec2i	moveDirection = voxelToChunkPosition(newPosition) - playerOnChunk;
-	Stopwatch timer;
+	const Time	now = Clock::now();
+	const float	elapsed = std::chrono::duration<float>(now - lastUpdate).count();
+	vec3		moved = newPosition - rawPosition;
+	vec3		forward = viewDirection;
 
-	timer.start();
-	if (moveDirection == vec2i::zero())
+	moved.y = 0.0f;
+	if (elapsed > 0.0f)
 	{
-		return false;
+		velocity = velocity * 0.75f + moved * (0.25f / elapsed);
+	}
+	if (moved.lengthSquared() > 0.0f)
+	{
+		travelDirection = moved.normalize();
 	}
-	playerOnChunk = playerOnChunk + moveDirection;
 	rawPosition = newPosition;
-	if (squareSize < 2)
+	lastUpdate = now;
+	forward.y = 0.0f;
+	if (forward.lengthSquared() > 0.0f)
+	{
+		forward.normalize();
+	}
+
+	const StreamView	view{newPosition, forward, travelDirection};
+	const vec2i			currentChunk = voxelToChunkPosition(newPosition);
+
+	if (currentChunk != epochChunk)
 	{
+		epochChunk = currentChunk;
+		epoch.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	if (stream != nullptr)
+	{
+		const bool	ready = stream->state.load(std::memory_order_acquire) == StreamState::Ready;
+		bool		installed;
+
+		{
+			std::lock_guard<std::mutex> lock(stream->queueMutex);
+
+			stream->view = view;
+			installed = stream->finished.empty() == true && pendingInstalls.empty() == true;
+		}
+		if (ready == false || installed == false)
+		{
+			return false;
+		}
+		finishStep();
+		return true;
+	}
+
+	if (requestedRadius != viewRadius)
+	{
+		resize(requestedRadius, view);
+		return true;
+	}
+
+	const vec2i	moveDirection = currentChunk - playerOnChunk;
+
+	// a step that doesn't move fills the slots of the jobs cancelled by the last one
+	if (moveDirection == vec2i::zero() && mapComplete == false)
+	{
+		startStep(moveDirection, view);
 		return false;
 	}
-	while (moveDirection.depth > 0)
+	if (moveDirection == vec2i::zero())
 	{
-		north();
-		moveDirection.depth--;
+		prefetch();
+		return false;
 	}
-	while (moveDirection.width > 0)
+	startStep(moveDirection, view);
+	return false;
+}
+
+/*	Change the view distance around the chunk of the player. The chunks that stay in view move to their
+	slot of the new square, the others are dropped right away, then a step that doesn't move streams
+	the chunks new to the view like any other step. */
+
+void	VoxelMap::resize(i32 radius, const StreamView& view)
+{
+	std::vector<ChunkPtr>	previous;
+
+	previous.swap(map);
+	viewRadius = radius;
+	squareSize = radius * 2 + 1;
+	map.resize(squareSize * squareSize);
+	for (ChunkPtr& chunk : previous)
 	{
-		east();
-		moveDirection.width--;
+		if (chunk == nullptr)
+		{
+			continue;
+		}
+		if (inView(chunk->getLocation(), playerOnChunk) == true)
+		{
+			map[slotOf(chunk->getLocation())] = std::move(chunk);
+			continue;
+		}
+		evict(std::move(chunk));
 	}
-	while (moveDirection.depth < 0)
+	minPositions = vec2i{playerOnChunk.x - radius, playerOnChunk.y - radius};
+	maxPositions = vec2i{minPositions.x + squareSize - 1, minPositions.y + squareSize - 1};
+	std::cout << "View distance: " << radius << " chunks, " << visibleChunkCount(radius) << " visible" << std::endl;
+	startStep(vec2i::zero(), view);
+}
+
+/*	Whether a chunk dx, dz chunks away from the centre is kept, in the shape of Config::viewShape. */
+
+bool	VoxelMap::insideShape(i32 dx, i32 dz, i32 radius) noexcept
+{
+	dx = std::abs(dx);
+	dz = std::abs(dz);
+	switch (Config::viewShape)
 	{
-		south();
-		moveDirection.depth++;
+		case ViewShape::Circle:
+			// radius of radius + 0.5 chunk, so the outline doesn't end on a single chunk per axis
+			return dx * dx + dz * dz <= radius * radius + radius;
+		case ViewShape::Diamond:
+			return dx + dz <= radius;
+		case ViewShape::Square:
+			break;
 	}
-	while (moveDirection.width < 0)
+	return dx <= radius && dz <= radius;
+}
+
+i32	VoxelMap::visibleChunkCount(i32 radius) noexcept
+{
+	i32 count = 0;
+
+	for (i32 dz = -radius; dz <= radius; dz++)
 	{
-		west();
-		moveDirection.width++;
+		for (i32 dx = -radius; dx <= radius; dx++)
+		{
+			if (insideShape(dx, dz, radius) == true)
+			{
+				count++;
+			}
+		}
 	}
-	timer.stop();
-	threadManager.waitIdle();
-	std::cout << "regeneration took: " << timer << std::endl;
-	// std::cout << "New map limits: " << minPositions << " to " << maxPositions << std::endl;
-	assert(minPositions.x + squareSize - 1 == maxPositions.x && "Error: min/max X don't line up");
-	assert(minPositions.y + squareSize - 1 == maxPositions.y && "Error: min/max Y don't line up");
-	return true;
+	return count;
 }
 
-void	VoxelMap::meshRow(i32 index)
+bool	VoxelMap::inView(const vec2i& location, const vec2i& centre) const noexcept
 {
-	for (i32 i = 0; i < squareSize; i++)
+	return insideShape(location.x - centre.x, location.y - centre.y, viewRadius);
+}
+
+/*	Level of detail of a chunk, from its distance in chunks to the chunk of the player (square rings). */
+
+ui8	VoxelMap::lodFor(const vec2i& chunkLocation, const vec2i& centre) const noexcept
+{
+	const vec2i offset = chunkLocation - centre;
+	const i32 distance = std::max(std::abs(offset.x), std::abs(offset.y));
+	ui8 level = 0;
+
+	while (level < Config::lodDistances.size() && distance >= Config::lodDistances[level])
+	{
+		level++;
+	}
+	return level;
+}
+
+/*	Lower runs sooner: the distance from the camera, minus up to a chunk along the direction of travel.
+	Chunks outside the view come after every chunk inside it, the view is taken as a cone as wide as
+	the vertical field of view, which covers the horizontal one of usual aspect ratios. */
+
+float	VoxelMap::streamPriority(const StreamJob& job, const StreamView& view) const noexcept
+{
+	static const float	viewCone = std::cos(radians(CameraSettings::projectionFov));
+	const float			length = static_cast<float>(Config::chunkLength);
+	vec3				toChunk{
+		(static_cast<float>(job.location.x) + 0.5f) * length - view.position.x,
+		0.0f,
+		(static_cast<float>(job.location.y) + 0.5f) * length - view.position.z
+	};
+	const float			distance = toChunk.length();
+	float				priority = distance;
+
+	// the chunks around the player are always needed
+	if (distance < length)
+	{
+		return priority;
+	}
+	toChunk.normalize();
+	if (view.forward.lengthSquared() > 0.0f && vec3::dot(toChunk, view.forward) < viewCone)
+	{
+		priority += static_cast<float>(squareSize) * length;
+	}
+	priority -= vec3::dot(toChunk, view.travel) * length;
+	return priority;
+}
+
+/*	Chunk offsets towards each Direction. */
+
+static constexpr std::array<std::array<i32, 2>, 4>	directionOffsets{{{0, 1}, {1, 0}, {0, -1}, {-1, 0}}};
+
+/*	Plan the move of the window by offset, in chunks. Every location of the new window keeps the chunk of
+	its slot if it is already there at the right level of detail, otherwise it gets a new chunk: only the
+	difference between the two windows is generated, and a jump further than the window is a fresh load. The chunks that
+	stay and touch a new one rebuild the border facing it. A slot can mesh once the new chunks among
+	itself and its neighbours are generated, blockers counts them down. */
+
+void	VoxelMap::startStep(const vec2i& offset, const StreamView& view)
+{
+	std::shared_ptr<StreamStep>	step = std::make_shared<StreamStep>();
+	std::vector<StreamJob>		jobs;
+	i32							borderCount = 0;
+
+	std::vector<bool>			generating(map.size(), false);
+
+	step->timer.start();
+	step->minPositions = minPositions + offset;
+	step->playerOnChunk = playerOnChunk + offset;
+	step->incoming.resize(map.size());
+	step->incomingCount = 0;
+	step->prefetchedCount = 0;
+	step->cachedCount = 0;
+	step->borderSides.assign(map.size(), 0);
+	step->blockers = std::vector<std::atomic<i32>>(map.size());
+	step->cancelled.assign(map.size(), NotCancelled);
+	step->cancelledCount.store(0, std::memory_order_relaxed);
+	step->epoch = epoch.load(std::memory_order_relaxed);
+	step->view = view;
+	for (i32 z = 0; z < squareSize; z++)
+	{
+		for (i32 x = 0; x < squareSize; x++)
+		{
+			const vec2i	location{step->minPositions.x + x, step->minPositions.y + z};
+			const i32	slot = slotOf(location);
+
+			if (inView(location, step->playerOnChunk) == false)
+			{
+				continue;
+			}
+
+			const ui8	level = lodFor(location, step->playerOnChunk);
+
+			if (map[slot] != nullptr && map[slot]->getLocation() == location && map[slot]->getLod() == level)
+			{
+				continue;
+			}
+			step->incoming[slot] = takePrefetched(location, level);
+			step->incomingCount++;
+			if (step->incoming[slot] != nullptr)
+			{
+				step->prefetchedCount++;
+				continue;
+			}
+			step->incoming[slot] = takeCached(location, level);
+			if (step->incoming[slot] != nullptr)
+			{
+				step->cachedCount++;
+				continue;
+			}
+			step->incoming[slot] = std::make_shared<VoxelChunk>(location);
+			step->incoming[slot]->setLod(level);
+			generating[slot] = true;
+			jobs.push_back(StreamJob{StreamTask::Generate, slot, location});
+		}
+	}
+	for (i32 slot = 0; slot < static_cast<i32>(map.size()); slot++)
 	{
-		map[index].generateVertexes();
-		index++;
+		if (map[slot] != nullptr && step->incoming[slot] == nullptr
+			&& inView(map[slot]->getLocation(), step->playerOnChunk) == false)
+		{
+			step->vacated.push_back(slot);
+		}
 	}
+	for (i32 z = 0; z < squareSize; z++)
+	{
+		for (i32 x = 0; x < squareSize; x++)
+		{
+			const vec2i	location{step->minPositions.x + x, step->minPositions.y + z};
+			const i32	slot = slotOf(location);
+			i32			blockers = generating[slot] == true ? 1 : 0;
+			ui8			sides = 0;
+
+			if (inView(location, step->playerOnChunk) == false)
+			{
+				continue;
+			}
+			for (size_t side = 0; side < directionOffsets.size(); side++)
+			{
+				const vec2i neighbour{location.x + directionOffsets[side][0], location.y + directionOffsets[side][1]};
+
+				if (inView(neighbour, step->playerOnChunk) == false)
+				{
+					continue;
+				}
+				if (step->incoming[slotOf(neighbour)] != nullptr)
+				{
+					blockers += generating[slotOf(neighbour)] == true ? 1 : 0;
+					sides |= 1 << side;
+				}
+			}
+			step->blockers[slot].store(blockers, std::memory_order_relaxed);
+			if (step->incoming[slot] == nullptr && sides != 0)
+			{
+				step->borderSides[slot] = sides;
+				borderCount++;
+			}
+			// prefetched chunks are generated already, what only waits on them can run now
+			if (blockers == 0 && step->incoming[slot] != nullptr)
+			{
+				jobs.push_back(StreamJob{StreamTask::Mesh, slot, location});
+			}
+			else if (blockers == 0 && sides != 0)
+			{
+				jobs.push_back(StreamJob{StreamTask::Border, slot, location});
+			}
+		}
+	}
+	step->pending.store(step->incomingCount + borderCount, std::memory_order_relaxed);
+	step->state.store(step->incomingCount + borderCount == 0 ? StreamState::Ready : StreamState::Streaming,
+		std::memory_order_relaxed);
+	stream = step;
+	pushJobs(step, jobs);
 }
 
-void	VoxelMap::meshColumn(i32 index)
+/*	Queue jobs that can run now, and as many pool jobs to run them. Nothing is queued once the map is
+	being destroyed. */
+
+void	VoxelMap::pushJobs(const std::shared_ptr<StreamStep>& step, const std::vector<StreamJob>& jobs)
 {
-	for (i32 i = 0; i < squareSize; i++)
+	if (jobs.empty() == true || closing.load(std::memory_order_relaxed) == true)
+	{
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(step->queueMutex);
+
+		step->ready.insert(step->ready.end(), jobs.begin(), jobs.end());
+	}
+	for (size_t i = 0; i < jobs.size(); i++)
 	{
-		map[index].generateVertexes();
-		index += squareSize;
+		threadManager.submit(poolTasks, TaskPriority::Urgent, [this, step] {
+			runStepJob(step);
+		});
 	}
 }
 
-void	VoxelMap::generateRow(i32 index)
+/*	Runs the most urgent ready job of the step, seen from where the player is now. A generated chunk
+	unblocks itself and its neighbours, the last one of a slot queues its Mesh or Border job. */
+
+void	VoxelMap::runStepJob(const std::shared_ptr<StreamStep>& step)
 {
-	const i32 Ycoord = minPositions.y + index / squareSize;
+	StreamJob	job;
+	bool		stale;
+
+	{
+		std::lock_guard<std::mutex> lock(step->queueMutex);
+		size_t	best = 0;
+		float	bestPriority = streamPriority(step->ready[0], step->view);
+
+		for (size_t i = 1; i < step->ready.size(); i++)
+		{
+			const float priority = streamPriority(step->ready[i], step->view);
 
-	for (i32 i = 0; i < squareSize; i++)
+			if (priority < bestPriority)
+			{
+				best = i;
+				bestPriority = priority;
+			}
+		}
+		job = step->ready[best];
+		step->ready[best] = step->ready.back();
+		step->ready.pop_back();
+		stale = isStale(*step, job);
+	}
+	if (stale == true)
 	{
-		map[index].setLocation({minPositions.x + i, Ycoord});
-		map[index].generateMap(worldSeed);
-		index++;
+		step->cancelledCount.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	switch (job.task)
+	{
+		case StreamTask::Generate:
+		{
+			std::vector<StreamJob>	unblocked;
+
+			// the neighbours are released all the same, they only read the padding of a missing chunk
+			if (stale == true)
+			{
+				step->cancelled[job.slot] = NotGenerated;
+			}
+			else
+			{
+				step->incoming[job.slot]->generateMap(worldSeed);
+			}
+			releaseSlot(*step, job.slot, unblocked);
+			for (const std::array<i32, 2>& offset : directionOffsets)
+			{
+				const vec2i location{job.location.x + offset[0], job.location.y + offset[1]};
+
+				if (chunkAt(location, step.get()) != nullptr)
+				{
+					releaseSlot(*step, slotOf(location), unblocked);
+				}
+			}
+			pushJobs(step, unblocked);
+			break;
+		}
+		case StreamTask::Mesh:
+		{
+			const ChunkPtr& chunk = step->incoming[job.slot];
+
+			if (stale == true || step->cancelled[job.slot] != NotCancelled)
+			{
+				if (step->cancelled[job.slot] == NotCancelled)
+				{
+					step->cancelled[job.slot] = NotMeshed;
+				}
+				finishJob(*step);
+				break;
+			}
+			chunk->copyAdjacentData(neighboursOf(job.location, step.get()));
+			chunk->generateVertexes();
+			{
+				std::lock_guard<std::mutex> lock(step->queueMutex);
+
+				step->finished.push_back(job.slot);
+			}
+			finishJob(*step);
+			break;
+		}
+		case StreamTask::Border:
+		{
+			const Neighbours	neighbours = neighboursOf(job.location, step.get());
+			const ui8			sides = step->borderSides[job.slot];
+
+			if (stale == true)
+			{
+				finishJob(*step);
+				break;
+			}
+			for (ui8 side = 0; side < 4; side++)
+			{
+				if ((sides & (1 << side)) != 0)
+				{
+					map[job.slot]->remeshBorder(static_cast<Direction>(side), *neighbours[side]);
+				}
+			}
+			finishJob(*step);
+			break;
+		}
 	}
 }
 
-void	VoxelMap::generateColumn(i32 index)
+void	VoxelMap::releaseSlot(StreamStep& step, i32 slot, std::vector<StreamJob>& unblocked)
 {
-	const i32 Xcoord = minPositions.x + index % squareSize;
+	if (step.blockers[slot].fetch_sub(1, std::memory_order_acq_rel) != 1)
+	{
+		return;
+	}
+	if (step.incoming[slot] != nullptr)
+	{
+		unblocked.push_back(StreamJob{StreamTask::Mesh, slot, step.incoming[slot]->getLocation()});
+	}
+	else
+	{
+		unblocked.push_back(StreamJob{StreamTask::Border, slot, map[slot]->getLocation()});
+	}
+}
+
+/*	Whether the chunk of a job left the view of the player since the step was planned, or the map is
+	being destroyed. Only looked at once the player entered another chunk, called with the queue locked. */
 
-	for (i32 i = 0; i < squareSize; i++)
+bool	VoxelMap::isStale(const StreamStep& step, const StreamJob& job) const noexcept
+{
+	if (closing.load(std::memory_order_relaxed) == true)
 	{
-		map[index].setLocation({Xcoord, minPositions.y + i});
-		map[index].generateMap(worldSeed);
-		index += squareSize;
+		return true;
 	}
+	if (epoch.load(std::memory_order_relaxed) == step.epoch)
+	{
+		return false;
+	}
+	return inView(job.location, voxelToChunkPosition(step.view.position)) == false;
 }
 
-void	VoxelMap::north()
+void	VoxelMap::finishJob(StreamStep& step) noexcept
 {
-	minPositions.y += 1;
-	maxPositions.y += 1;
+	if (step.pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		step.state.store(StreamState::Ready, std::memory_order_release);
+	}
+}
 
-	std::rotate(map.begin(), map.begin() + squareSize, map.end());
-	setAdjacentPointers();
+/*	Every job of the step is done and its new chunks are in: the kept chunks that rebuilt a border go back to the render loop, and
+	the chunks that left the view without a replacement are dropped. */
 
-	const i32 bottomRowIndex = squareSize * (squareSize - 1);
-	generateRow(bottomRowIndex);
-	meshRow(bottomRowIndex);
-	meshRow(bottomRowIndex - squareSize);
+void	VoxelMap::finishStep()
+{
+	for (i32 slot : stream->vacated)
+	{
+		evict(std::move(map[slot]));
+	}
+	for (i32 slot = 0; slot < static_cast<i32>(map.size()); slot++)
+	{
+		if (stream->borderSides[slot] != 0)
+		{
+			pendingUploads.push_back(map[slot]);
+		}
+		if (stream->cancelled[slot] == NotCancelled)
+		{
+			continue;
+		}
+		// the slot kept its previous chunk, which may be out of the view of the step
+		if (map[slot] != nullptr && inView(map[slot]->getLocation(), stream->playerOnChunk) == false)
+		{
+			evict(std::move(map[slot]));
+		}
+		if (stream->cancelled[slot] == NotMeshed)
+		{
+			evict(std::move(stream->incoming[slot]));
+		}
+	}
+	mapComplete = stream->cancelledCount.load(std::memory_order_relaxed) == 0;
+	minPositions = stream->minPositions;
+	maxPositions = vec2i{minPositions.x + squareSize - 1, minPositions.y + squareSize - 1};
+	playerOnChunk = stream->playerOnChunk;
+	stream->timer.stop();
+	std::cout << "regeneration of " << stream->incomingCount << " chunks (" << stream->prefetchedCount
+		<< " prefetched, " << stream->cachedCount << " cached, " << stream->cancelledCount.load(std::memory_order_relaxed)
+		<< " jobs cancelled) took: " << stream->timer << std::endl;
+	stream.reset();
+	checkMemoryBudget();
 }
 
-void	VoxelMap::south()
+ui64	VoxelMap::locationKey(const vec2i& location) noexcept
 {
-	minPositions.y -= 1;
-	maxPositions.y -= 1;
-	
-    std::rotate(map.begin(), map.end() - squareSize, map.end());
-	setAdjacentPointers();
-	
-	generateRow(0);
-	meshRow(0);
-	meshRow(0 + squareSize);
+	return (static_cast<ui64>(static_cast<ui32>(location.x)) << 32) | static_cast<ui32>(location.y);
 }
 
-void	VoxelMap::west()
+/*	Generate the chunks the view will reach next while the map is idle. The view is moved ahead along
+	the velocity, by prefetchSeconds of travel and at most prefetchRings chunks per axis, and the chunks
+	of that view not in the current one are generated on the pool, closest to the player first. The
+	prefetched chunks that fell behind are dropped. Prefetch jobs run in the background lane, the ones
+	still ahead and one ring away from the view are raised to the normal lane. */
+
+void	VoxelMap::prefetch()
 {
-	minPositions.x -= 1;
-	maxPositions.x -= 1;
+	const float	reach = Config::prefetchSeconds / static_cast<float>(Config::chunkLength);
+	const vec2i	ahead{
+		std::clamp(static_cast<i32>(std::round(velocity.x * reach)), -Config::prefetchRings, Config::prefetchRings),
+		std::clamp(static_cast<i32>(std::round(velocity.z * reach)), -Config::prefetchRings, Config::prefetchRings)
+	};
+	const vec2i	predicted = playerOnChunk + ahead;
+	i32			inFlight = 0;
 
-	for (i32 row = 0; row < squareSize; row++)
+	for (auto it = prefetched.begin(); it != prefetched.end();)
 	{
-		auto begin = map.begin() + row * squareSize;
-		std::rotate(begin, begin + (squareSize - 1), begin + squareSize);
+		const vec2i	location = it->second->chunk->getLocation();
+
+		if (inView(location, playerOnChunk) == true
+			|| insideShape(location.x - playerOnChunk.x, location.y - playerOnChunk.y, viewRadius + Config::prefetchRings) == false)
+		{
+			it->second->dropped.store(true, std::memory_order_relaxed);
+			it = prefetched.erase(it);
+			continue;
+		}
+		if (it->second->generated.load(std::memory_order_relaxed) == false)
+		{
+			if (inView(location, predicted) == true
+				&& insideShape(location.x - playerOnChunk.x, location.y - playerOnChunk.y, viewRadius + 1) == true)
+			{
+				threadManager.raise(it->second->task, TaskPriority::Normal);
+			}
+			inFlight++;
+		}
+		it++;
 	}
-	setAdjacentPointers();
+	if (ahead == vec2i::zero() || inFlight >= Config::prefetchJobs)
+	{
+		return;
+	}
+
+	std::vector<vec2i>	candidates;
+
+	for (i32 z = predicted.y - viewRadius; z <= predicted.y + viewRadius; z++)
+	{
+		for (i32 x = predicted.x - viewRadius; x <= predicted.x + viewRadius; x++)
+		{
+			const vec2i location{x, z};
+
+			if (inView(location, predicted) == true && inView(location, playerOnChunk) == false
+				&& prefetched.contains(locationKey(location)) == false
+				&& cache[lodFor(location, predicted)].contains(locationKey(location)) == false)
+			{
+				candidates.push_back(location);
+			}
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(), [this](const vec2i& a, const vec2i& b) {
+		const vec2i da = a - playerOnChunk;
+		const vec2i db = b - playerOnChunk;
+
+		return da.x * da.x + da.y * da.y < db.x * db.x + db.y * db.y;
+	});
+	for (const vec2i& location : candidates)
+	{
+		if (inFlight >= Config::prefetchJobs)
+		{
+			break;
+		}
+
+		std::shared_ptr<Prefetch>	entry = std::make_shared<Prefetch>();
+
+		entry->chunk = std::make_shared<VoxelChunk>(location);
+		entry->chunk->setLod(lodFor(location, predicted));
+		prefetched.emplace(locationKey(location), entry);
+		entry->task = threadManager.submitRaisable(poolTasks, TaskPriority::Background, [entry, seed = worldSeed] {
+			if (entry->dropped.load(std::memory_order_relaxed) == true)
+			{
+				return;
+			}
+			entry->chunk->generateMap(seed);
+			entry->generated.store(true, std::memory_order_release);
+		});
+		inFlight++;
+	}
+}
+
+/*	The prefetched chunk of location if it is generated at level, nullptr otherwise. Either way the
+	location leaves the prefetched ones, a job that didn't start yet is skipped and one still generating
+	keeps the chunk alive until it ends. */
+
+VoxelMap::ChunkPtr	VoxelMap::takePrefetched(const vec2i& location, ui8 level)
+{
+	const auto	it = prefetched.find(locationKey(location));
+	ChunkPtr	chunk;
+
+	if (it == prefetched.end())
+	{
+		return nullptr;
+	}
+	if (it->second->generated.load(std::memory_order_acquire) == true && it->second->chunk->getLod() == level)
+	{
+		chunk = it->second->chunk;
+	}
+	it->second->dropped.store(true, std::memory_order_relaxed);
+	prefetched.erase(it);
+	return chunk;
+}
 
-	generateColumn(0);
-	meshColumn(0);
-	meshColumn(1);
+/*	A chunk leaves the map: its mesh retires like the ones replaced by uploadMeshes, its voxels go to
+	the front of the cache, which drops the least recently evicted chunk once full. */
+
+void	VoxelMap::evict(ChunkPtr chunk)
+{
+	std::unique_ptr<ve::VulkanModel>	mesh = chunk->releaseMesh();
+	auto&								levelCache = cache[chunk->getLod()];
+	const ui64							key = locationKey(chunk->getLocation());
+	const auto							it = levelCache.find(key);
+
+	if (mesh != nullptr)
+	{
+		retiredMeshes.push_back(RetiredMesh{uploadFrame + 1, std::move(mesh)});
+	}
+	if (Config::chunkCacheSize == 0)
+	{
+		return;
+	}
+	if (it != levelCache.end())
+	{
+		cacheOrder.erase(it->second);
+	}
+	cacheOrder.push_front(std::move(chunk));
+	levelCache[key] = cacheOrder.begin();
+	if (cacheOrder.size() > Config::chunkCacheSize)
+	{
+		cache[cacheOrder.back()->getLod()].erase(locationKey(cacheOrder.back()->getLocation()));
+		cacheOrder.pop_back();
+	}
 }
 
-void	VoxelMap::east()
+/*	The chunk of location evicted at level, nullptr if it is not cached. */
+
+VoxelMap::ChunkPtr	VoxelMap::takeCached(const vec2i& location, ui8 level)
 {
-	minPositions.x += 1;
-	maxPositions.x += 1;
+	auto&		levelCache = cache[level];
+	const auto	it = levelCache.find(locationKey(location));
+	ChunkPtr	chunk;
 
-	for (i32 row = 0; row < squareSize; row++)
+	if (it == levelCache.end())
 	{
-		auto begin = map.begin() + row * squareSize;
-		std::rotate(begin, begin + 1, begin + squareSize);
+		cacheMisses++;
+		return nullptr;
 	}
-	setAdjacentPointers();
+	chunk = std::move(*it->second);
+	cacheOrder.erase(it->second);
+	levelCache.erase(it);
+	cacheHits++;
+	return chunk;
+}
 
-	generateColumn(squareSize - 1);
-	meshColumn(squareSize - 1);
-	meshColumn(squareSize - 2);
+/*	Meshing runs in two phases on the thread pool. First every chunk copies the borders of its
+	neighbours into its padding: chunks only read the inside of each other and only write their own
+	padding, so the copies don't race. Once they are all done, every chunk meshes from its own map. */
+
+void	VoxelMap::meshChunks()
+{
+	threadManager.parallel_for(0, map.size(), 1, [this](size_t slot) {
+		if (map[slot] != nullptr)
+		{
+			map[slot]->copyAdjacentData(neighboursOf(map[slot]->getLocation()));
+		}
+	});
+	threadManager.parallel_for(0, map.size(), 1, [this](size_t slot) {
+		if (map[slot] != nullptr)
+		{
+			map[slot]->generateVertexes();
+		}
+	});
 }
 
-}	//namespace vox
\ No newline at end of file
+}	//namespace vox
@@ -13,35 +13,31 @@
 namespace vox {
 
 /**
- * Get the vertex+texture+normal coordinates of a voxel. The texture coordinates are supposed to
- * apply a whole texture on every face of the voxel
- *
- * @param voxelLocation The origin of the voxel in a 3D space, the coordinates are relative
- * from such position (default is (0.0f, 0.0f, 0.0f))
+ * Append the 4 packed vertexes of one face of a box to a vertex buffer. A box of size 1 is a single voxel,
+ * a bigger box is a merged (greedy) face that covers several coplanar voxels
  *
- * @return a vector of 24 (fixed number of vertexes per voxel) 
- * instances of ve::VulkanModel::Vertex
+ * @param location The minimum corner of the box inside the chunk
+ * @param chunk vertex buffer the face gets appended to
+ * @param min index of the first vertex of the face inside VOXEL_VERTEXES (see VertexFaces)
+ * @param type voxel type stored in the vertexes
+ * @param chunkLocation chunk coordinates packed by packChunkLocation
+ * @param size extent of the box along each axis
  */
 
-void	addVoxelFace(const vec3& location, VertexVector& chunk, size_t min)
+void	addVoxelFace(const vec3i& location, VertexVector& chunk, size_t min, VoxelType type, ui32 chunkLocation, const vec3i& size)
 {
 	size_t max = min + 4;
 
 	for (size_t i = min; i < max; i++)
 	{
-		chunk.emplace_back
-		(
-			ve::VulkanModel::Vertex
-			{
-				vec3
-				{
-					VOXEL_VERTEXES[i].pos.x + VOXEL_SIZE * 0.5f + location.x,
-					VOXEL_VERTEXES[i].pos.y + VOXEL_SIZE * 0.5f + location.y,
-					VOXEL_VERTEXES[i].pos.z + VOXEL_SIZE * 0.5f + location.z
-				},
-			VOXEL_VERTEXES[i].normal,
-			VOXEL_VERTEXES[i].textureUv
-		});
+		// VOXEL_VERTEXES corners are at -0.5 or 0.5, which selects the near or the far side of the box
+		vec3i corner
+		{
+			location.x + (VOXEL_VERTEXES[i].pos.x > 0.0f ? size.x : 0),
+			location.y + (VOXEL_VERTEXES[i].pos.y > 0.0f ? size.y : 0),
+			location.z + (VOXEL_VERTEXES[i].pos.z > 0.0f ? size.z : 0)
+		};
+		chunk.emplace_back(TerrainVertex{{packVertexPosition(corner, min, type), chunkLocation}});
 	}
 }
 
@@ -86,7 +82,7 @@ enum FaceBit : int
     BOTTOM = 1 << 5
 };
 
-void	addVertexes(const vec3& voxelLocation, VertexVector& chunk, int facesToAdd)
+void	addVertexes(const vec3i& voxelLocation, VertexVector& chunk, int facesToAdd, VoxelType type, ui32 chunkLocation)
 {
 	for (int bit = 0; bit < 6; bit++)
 	{
@@ -95,12 +91,12 @@ void	addVertexes(const vec3& voxelLocation, VertexVector& chunk, int facesToAdd)
 
 		switch (mask)
 		{
-			case FRONT: addVoxelFace(voxelLocation, chunk, static_cast<size_t>(VertexFaces::FRONT)); break;
-			case BACK: addVoxelFace(voxelLocation, chunk, static_cast<size_t>(VertexFaces::BACK)); break;
-			case LEFT: addVoxelFace(voxelLocation, chunk, static_cast<size_t>(VertexFaces::LEFT)); break;
-			case RIGHT: addVoxelFace(voxelLocation, chunk, static_cast<size_t>(VertexFaces::RIGHT)); break;
-			case TOP: addVoxelFace(voxelLocation, chunk, static_cast<size_t>(VertexFaces::TOP)); break;
-			case BOTTOM: addVoxelFace(voxelLocation, chunk, static_cast<size_t>(VertexFaces::BOTTOM)); break;
+			case FRONT: addVoxelFace(voxelLocation, chunk, static_cast<size_t>(VertexFaces::FRONT), type, chunkLocation); break;
+			case BACK: addVoxelFace(voxelLocation, chunk, static_cast<size_t>(VertexFaces::BACK), type, chunkLocation); break;
+			case LEFT: addVoxelFace(voxelLocation, chunk, static_cast<size_t>(VertexFaces::LEFT), type, chunkLocation); break;
+			case RIGHT: addVoxelFace(voxelLocation, chunk, static_cast<size_t>(VertexFaces::RIGHT), type, chunkLocation); break;
+			case TOP: addVoxelFace(voxelLocation, chunk, static_cast<size_t>(VertexFaces::TOP), type, chunkLocation); break;
+			case BOTTOM: addVoxelFace(voxelLocation, chunk, static_cast<size_t>(VertexFaces::BOTTOM), type, chunkLocation); break;
 			default: break;
 		}
 	}
@@ -1,14 +1,71 @@
 #include "Vox.hpp"
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
 #include <stdexcept>
+#include <string>
 #include <thread>
 
-int	main( void )
+static constexpr vox::ui64	megabyte = 1024 * 1024;
+
+/*	Value of a numeric option, the whole argument has to be a number from 1 to maximum. */
+
+static long	parseOption( const std::string& option, const char* value, long maximum )
+{
+	if (value == nullptr)
+	{
+		throw std::invalid_argument(option + " expects a value");
+	}
+
+	size_t	end = 0;
+	long	number = 0;
+
+	try
+	{
+		number = std::stol(value, &end);
+	}
+	catch (const std::logic_error&)
+	{
+		// not a number or out of the range of long, rejected below with the option name
+		number = 0;
+	}
+	if (value[end] != '\0' || number <= 0 || number > maximum)
+	{
+		throw std::invalid_argument(option + " expects a number from 1 to " + std::to_string(maximum) + ", got: " + value);
+	}
+	return number;
+}
+
+int	main( int argc, char** argv )
 {
 	try
 	{
-		vox::Vox app;
+		vox::i32	viewDistance = vox::Config::minimumViewingDistance / vox::Config::chunkLength;
+		vox::ui64	memoryBudget = 0;
+
+		for (int i = 1; i < argc; i++)
+		{
+			const std::string	option = argv[i];
+
+			if (option == "--render-distance")
+			{
+				viewDistance = static_cast<vox::i32>(parseOption(option, argv[++i], vox::Config::maximumViewDistance));
+			}
+			else if (option == "--memory-budget")
+			{
+				// in MiB, as many as fit in a ui64 once converted to bytes
+				const long	maximum = static_cast<long>(std::min<vox::ui64>(std::numeric_limits<vox::ui64>::max() / megabyte, std::numeric_limits<long>::max()));
+
+				memoryBudget = static_cast<vox::ui64>(parseOption(option, argv[++i], maximum)) * megabyte;
+			}
+			else
+			{
+				throw std::invalid_argument("unknown option: " + option);
+			}
+		}
+
+		vox::Vox app(viewDistance, memoryBudget);
 
 		app.setupVulkan();
 		app.run();